@@ -51,6 +51,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ADB_DATA_BIT    0
 //#define ADB_PSW_BIT     1       // optional
 
+/* ADB data pin interrupt to receive with interrupts enabled(optional) */
+#if defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__)
+#define ADB_INT_ON()    do {                        \
+    EICRA = (EICRA & ~(1<<ISC01)) | (1<<ISC00);     \
+    EIFR = (1<<INTF0);                              \
+    EIMSK |= (1<<INT0);                             \
+} while (0)
+#define ADB_INT_OFF()   do { EIMSK &= ~(1<<INT0); } while (0)
+#define ADB_INT_VECT    INT0_vect
+#endif
+
 /* key combination for command */
 #ifndef __ASSEMBLER__
 #include "adb.h"
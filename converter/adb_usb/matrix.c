@@ -21,7 +21,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/io.h>
-#include <util/delay.h>
 #include "print.h"
 #include "util.h"
 #include "debug.h"
@@ -29,6 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "matrix.h"
 #include "report.h"
 #include "host.h"
+#include "timer.h"
 
 
 #if (MATRIX_COLS > 16)
@@ -55,6 +55,24 @@ static uint16_t matrix[MATRIX_ROWS];
 static bool matrix_has_ghost_in_row(uint8_t row);
 #endif
 static void register_key(uint8_t key);
+static void adb_sched_init(void);
+static bool adb_slot(void);
+static uint16_t adb_poll(uint8_t *addr);
+
+enum {
+    INIT_PROBE,
+    INIT_EXTENDED,
+    INIT_MEDIA,
+    INIT_SCAN,
+    INIT_DONE,
+};
+static uint8_t init_state = INIT_PROBE;
+static uint8_t init_step;           // retry count or scan address
+static bool init_yield = false;     // next slot is for keyboard
+#ifdef ADB_MOUSE_ENABLE
+static uint16_t mouse_codes;
+static bool mouse_polled = false;
+#endif
 
 
 inline
@@ -75,54 +93,12 @@ void matrix_init(void)
     DDRD |= (1<<6); PORTD |= (1<<6);
 
     adb_host_init();
-    // wait for keyboard to boot up and receive command
-    _delay_ms(2000);
-
-    // device scan
-    xprintf("Before init:\n");
-    for (uint8_t addr = 1; addr < 16; addr++) {
-        uint16_t reg3 = adb_host_talk(addr, ADB_REG_3);
-        if (reg3) {
-            xprintf("Scan: addr:%d, reg3:%04X\n", addr, reg3);
-        }
-        _delay_ms(20);
-    }
 
-    // Determine ISO keyboard by handler id
-    // http://lxr.free-electrons.com/source/drivers/macintosh/adbhid.c?v=4.4#L815
-    uint16_t handler_id = adb_host_talk(ADB_ADDR_KEYBOARD, ADB_REG_3);
-    switch (handler_id) {
-    case 0x04: case 0x05: case 0x07: case 0x09: case 0x0D:
-    case 0x11: case 0x14: case 0x19: case 0x1D: case 0xC1:
-    case 0xC4: case 0xC7:
-        is_iso_layout = true;
-        break;
-    default:
-        is_iso_layout = false;
-        break;
-    }
-
-    // Adjustable keyboard media keys: address=0x07 and handlerID=0x02
-    has_media_keys = (0x02 == (adb_host_talk(ADB_ADDR_APPLIANCE, ADB_REG_3) & 0xff));
-    if (has_media_keys) {
-        xprintf("Found: media keys\n");
-    }
-
-    // Enable keyboard left/right modifier distinction
-    // Listen Register3
-    //  upper byte: reserved bits 0000, keyboard address 0010
-    //  lower byte: device handler 00000011
-    adb_host_listen(ADB_ADDR_KEYBOARD, ADB_REG_3, ADB_ADDR_KEYBOARD, ADB_HANDLER_EXTENDED_PROTOCOL);
-
-    // device scan
-    xprintf("After init:\n");
-    for (uint8_t addr = 1; addr < 16; addr++) {
-        uint16_t reg3 = adb_host_talk(addr, ADB_REG_3);
-        if (reg3) {
-            xprintf("Scan: addr:%d, reg3:%04X\n", addr, reg3);
-        }
-        _delay_ms(20);
-    }
+    // keyboard is brought up in matrix_scan()
+    init_state = INIT_PROBE;
+    init_yield = false;
+    has_media_keys = false;
+    adb_sched_init();
 
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
@@ -132,12 +108,84 @@ void matrix_init(void)
     //debug_keyboard = true;
     //debug_mouse = true;
     print("debug enabled.\n");
-
-    // LED off
-    DDRD |= (1<<6); PORTD &= ~(1<<6);
     return;
 }
 
+/*
+ * Device bring-up
+ *
+ * Done one bus transaction per slot in matrix_scan() instead of waiting for
+ * keyboard in matrix_init(). Keyboard is usable as soon as it answers Talk
+ * Register3, and then extended protocol, media keys and device scan are
+ * processed in every other slot in background.
+ */
+static void adb_init_task(void)
+{
+    uint16_t reg3;
+
+    switch (init_state) {
+    case INIT_PROBE:
+        // wait for keyboard to boot up and receive command
+        reg3 = adb_host_talk(ADB_ADDR_KEYBOARD, ADB_REG_3);
+        if (!reg3) return;
+        xprintf("Keyboard: reg3:%04X\n", reg3);
+
+        // Determine ISO keyboard by handler id
+        // http://lxr.free-electrons.com/source/drivers/macintosh/adbhid.c?v=4.4#L815
+        switch (reg3) {
+        case 0x04: case 0x05: case 0x07: case 0x09: case 0x0D:
+        case 0x11: case 0x14: case 0x19: case 0x1D: case 0xC1:
+        case 0xC4: case 0xC7:
+            is_iso_layout = true;
+            break;
+        default:
+            is_iso_layout = false;
+            break;
+        }
+
+        // Enable keyboard left/right modifier distinction
+        // Listen Register3
+        //  upper byte: reserved bits 0000, keyboard address 0010
+        //  lower byte: device handler 00000011
+        adb_host_listen(ADB_ADDR_KEYBOARD, ADB_REG_3, ADB_ADDR_KEYBOARD, ADB_HANDLER_EXTENDED_PROTOCOL);
+
+        // LED off
+        DDRD |= (1<<6); PORTD &= ~(1<<6);
+        init_step = 0;
+        init_state = INIT_EXTENDED;
+        break;
+    case INIT_EXTENDED:
+        // keyboard just booted up may miss Listen; old keyboards don't support it
+        reg3 = adb_host_talk(ADB_ADDR_KEYBOARD, ADB_REG_3);
+        if ((reg3 & 0xFF) == ADB_HANDLER_EXTENDED_PROTOCOL || ++init_step == 4) {
+            init_state = INIT_MEDIA;
+            break;
+        }
+        adb_host_listen(ADB_ADDR_KEYBOARD, ADB_REG_3, ADB_ADDR_KEYBOARD, ADB_HANDLER_EXTENDED_PROTOCOL);
+        break;
+    case INIT_MEDIA:
+        // Adjustable keyboard media keys: address=0x07 and handlerID=0x02
+        has_media_keys = (0x02 == (adb_host_talk(ADB_ADDR_APPLIANCE, ADB_REG_3) & 0xff));
+        if (has_media_keys) {
+            xprintf("Found: media keys\n");
+            adb_sched_init();
+        }
+        init_step = 1;
+        init_state = INIT_SCAN;
+        break;
+    case INIT_SCAN:
+        // device scan
+        reg3 = adb_host_talk(init_step, ADB_REG_3);
+        if (reg3) {
+            xprintf("Scan: addr:%d, reg3:%04X\n", init_step, reg3);
+        }
+        if (++init_step == 16) {
+            init_state = INIT_DONE;
+        }
+        break;
+    }
+}
+
 #ifdef ADB_MOUSE_ENABLE
 
 #ifdef MAX
@@ -150,8 +198,11 @@ void adb_mouse_task(void)
     uint16_t codes;
     int16_t x, y;
     static int8_t mouseacc;
-    _delay_ms(12);  // delay for preventing overload of poor ADB keyboard controller
-    codes = adb_host_mouse_recv();
+
+    // mouse is polled by bus scheduler in matrix_scan()
+    if (!mouse_polled) return;
+    mouse_polled = false;
+    codes = mouse_codes;
     // If nothing received reset mouse acceleration, and quit.
     if (!codes) {
         mouseacc = 1;
@@ -196,6 +247,92 @@ void adb_mouse_task(void)
 }
 #endif
 
+/*
+ * ADB bus scheduler
+ *
+ * One Talk is issued per ADB_POLL_INTERVAL. As ADB Manager of Mac does, the
+ * last device which sent data is polled and other devices are searched only
+ * when Service Request is seen on the bus; keyboard gets next slot even
+ * while mouse is streaming. Idle devices are polled at backed off interval
+ * in case their SRQ is disabled.
+ */
+#ifndef ADB_POLL_INTERVAL
+#define ADB_POLL_INTERVAL   12      // ms, poor keyboard controllers miss strokes if shorter
+#endif
+#define ADB_BACKOFF_MAX     32      // slots
+
+#define ADB_SCHED_DEVS      3
+static uint8_t dev_addr[ADB_SCHED_DEVS];
+static uint8_t dev_backoff[ADB_SCHED_DEVS];
+static uint8_t dev_wait[ADB_SCHED_DEVS];
+static uint8_t dev_count = 0;
+static uint8_t active = 0;          // last device which sent data
+static uint8_t polled = 0;          // last device polled
+
+static void adb_sched_init(void)
+{
+    dev_count = 0;
+    dev_addr[dev_count++] = ADB_ADDR_KEYBOARD;
+    if (has_media_keys) {
+        dev_addr[dev_count++] = ADB_ADDR_APPLIANCE;
+    }
+#ifdef ADB_MOUSE_ENABLE
+    dev_addr[dev_count++] = ADB_ADDR_MOUSE;
+#endif
+    for (uint8_t i = 0; i < dev_count; i++) {
+        dev_backoff[i] = 1;
+        dev_wait[i] = 0;
+    }
+    active = polled = 0;
+}
+
+/* Returns true when next slot has come */
+static bool adb_slot(void)
+{
+    static uint16_t last = 0;
+
+    if (timer_elapsed(last) < ADB_POLL_INTERVAL) return false;
+    last = timer_read();
+    return true;
+}
+
+/* Returns data of Talk register 0 and address of the device polled, or
+ * address 0 when it is not time to poll yet. */
+static uint16_t adb_poll(uint8_t *addr)
+{
+    *addr = 0;
+    if (!adb_slot()) return 0;
+
+    uint8_t dev = active;
+    for (uint8_t i = 0; i < dev_count; i++) {
+        if (dev_wait[i]) dev_wait[i]--;
+    }
+    if (adb_host_srq()) {
+        // requester is other than the device polled last
+        dev = (polled + 1) % dev_count;
+    } else {
+        for (uint8_t i = 0; i < dev_count; i++) {
+            if (i != active && dev_wait[i] == 0) {
+                dev = i;
+                break;
+            }
+        }
+    }
+
+    uint16_t codes = adb_host_talk(dev_addr[dev], ADB_REG_0);
+    if (codes) {
+        active = dev;
+        dev_backoff[dev] = 1;
+    } else if (dev != active) {
+        if (dev_backoff[dev] < ADB_BACKOFF_MAX) dev_backoff[dev] <<= 1;
+    }
+    dev_wait[dev] = dev_backoff[dev];
+    polled = dev;
+
+    *addr = dev_addr[dev];
+    return codes;
+}
+
 uint8_t matrix_scan(void)
 {
     /* extra_key is volatile and more convoluted than necessary because gcc refused
@@ -215,12 +352,27 @@ uint8_t matrix_scan(void)
 
     if ( codes == 0xFFFF )
     {
-        _delay_ms(12);  // delay for preventing overload of poor ADB keyboard controller
-        codes = adb_host_kbd_recv(ADB_ADDR_KEYBOARD);
+        if (init_state != INIT_DONE && !init_yield) {
+            if (adb_slot()) {
+                adb_init_task();
+                init_yield = (init_state != INIT_PROBE);
+            }
+            return 0;
+        }
+
+        uint8_t addr;
+        codes = adb_poll(&addr);
+        if (addr) init_yield = false;
+#ifdef ADB_MOUSE_ENABLE
+        if (addr == ADB_ADDR_MOUSE) {
+            mouse_codes = codes;
+            mouse_polled = true;
+            return 0;
+        }
+#endif
 
         // Adjustable keybaord media keys
-        if (codes == 0 && has_media_keys &&
-                (codes = adb_host_kbd_recv(ADB_ADDR_APPLIANCE))) {
+        if (addr == ADB_ADDR_APPLIANCE && codes) {
             // key1
             switch (codes & 0x7f ) {
             case 0x00:  // Mic
@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action.h"
 #include "print.h"
 #include "debug.h"
+#include "trace.h"
 #include "util.h"
 #include "ibm4704.h"
 #include "matrix.h"
@@ -108,14 +109,14 @@ uint8_t matrix_scan(void)
         return 0;
     } else if ((code&0x7F) >= 0x7C) {
         // 0xFF-FC and 0x7F-7C is not scancode
-        xprintf("Error: %02X\n", code);
+        trace_xprintf(TRACE_SCAN_ERROR, code, 0, "Error: %02X\n", code);
         matrix_clear();
         return 0;
     } else if (code&0x80) {
-        dprintf("%02X\n", code);
+        trace_dprintf(TRACE_SCAN_CODE, code, 0, "%02X\n", code);
         matrix_make(code);
     } else {
-        dprintf("%02X\n", code);
+        trace_dprintf(TRACE_SCAN_CODE, code, 0, "%02X\n", code);
         matrix_break(code);
     }
     return 1;
@@ -20,7 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action.h"
 #include "print.h"
 #include "util.h"
+#include "progmem.h"
 #include "debug.h"
+#include "trace.h"
 #include "ps2.h"
 #include "matrix.h"
 
@@ -28,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 static void matrix_make(uint8_t code);
 static void matrix_break(uint8_t code);
 static void matrix_clear(void);
+static void scan_code_set_init(void);
 #ifdef MATRIX_HAS_GHOST
 static bool matrix_has_ghost_in_row(uint8_t row);
 #endif
@@ -68,6 +71,10 @@ static uint8_t matrix[MATRIX_ROWS];
 
 static bool is_modified = false;
 
+#ifndef PS2_SCAN_STEP
+#define PS2_SCAN_STEP   4       // codes decoded per matrix_scan_step()
+#endif
+
 
 inline
 uint8_t matrix_rows(void)
@@ -89,6 +96,9 @@ void matrix_init(void)
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
 
+    // keyboard still in BAT doesn't respond, it is retried on its BAT code
+    scan_code_set_init();
+
     return;
 }
 
@@ -155,229 +165,331 @@ void matrix_init(void)
  *               because it has no break code.
  *
  */
-uint8_t matrix_scan(void)
+/*
+ * Scan code decoder
+ *
+ * Sequences above are decoded with transition table indexed by state and
+ * class of received code. Codes without exceptional role fall into class
+ * LOW(00-7F) or HIGH(80-FF). Each entry has next state in upper nibble and
+ * action in lower nibble; entry omitted in the table means 'back to INIT
+ * with no action', that is, broken sequence is discarded silently.
+ */
+enum {
+    INIT,
+    F0,
+    E0,
+    E0_F0,
+    // Pause
+    E1,
+    E1_14,
+    E1_14_77,
+    E1_14_77_E1,
+    E1_14_77_E1_F0,
+    E1_14_77_E1_F0_14,
+    E1_14_77_E1_F0_14_F0,
+    // Control'd Pause
+    E0_7E,
+    E0_7E_E0,
+    E0_7E_E0_F0,
+    STATE_COUNT
+};
+
+enum {
+    C_LOW,
+    C_HIGH,
+    C_00,
+    C_12,
+    C_14,
+    C_59,
+    C_77,
+    C_7E,
+    C_83,
+    C_84,
+    C_AA,
+    C_E0,
+    C_E1,
+    C_F0,
+    CLASS_COUNT
+};
+
+enum {
+    A_NONE,
+    A_MAKE,             // code
+    A_BREAK,
+    A_MAKE_E0,          // code|0x80
+    A_BREAK_E0,
+    A_MAKE_F7,
+    A_BREAK_F7,
+    A_MAKE_PRINT_SCREEN,
+    A_BREAK_PRINT_SCREEN,
+    A_MAKE_PAUSE,
+    A_OVERRUN,
+    A_ERROR,
+    A_RESET,            // BAT completion: keyboard is plugged or reset
+};
+
+#define T(next, action) (((next)<<4) | (action))
+
+// all of codes 00-7F in one class except for listed ones
+#define LOW_CLASSES(next, action) \
+    [C_LOW] = T(next, action), [C_00] = T(next, action), [C_12] = T(next, action), \
+    [C_14] = T(next, action),  [C_59] = T(next, action), [C_77] = T(next, action), \
+    [C_7E] = T(next, action)
+#define HIGH_CLASSES(next, action) \
+    [C_HIGH] = T(next, action), [C_83] = T(next, action), [C_84] = T(next, action), \
+    [C_AA] = T(next, action),   [C_E0] = T(next, action), [C_E1] = T(next, action), \
+    [C_F0] = T(next, action)
+
+static const uint8_t PROGMEM code_class[256] = {
+    [0x00] = C_00,
+    [0x01 ... 0x7F] = C_LOW,
+    [0x12] = C_12,
+    [0x14] = C_14,
+    [0x59] = C_59,
+    [0x77] = C_77,
+    [0x7E] = C_7E,
+    [0x80 ... 0xFF] = C_HIGH,
+    [0x83] = C_83,
+    [0x84] = C_84,
+    [0xAA] = C_AA,
+    [0xE0] = C_E0,
+    [0xE1] = C_E1,
+    [0xF0] = C_F0,
+};
+
+static const uint8_t PROGMEM transition[STATE_COUNT][CLASS_COUNT] = {
+    [INIT] = {
+        LOW_CLASSES(INIT, A_MAKE),
+        HIGH_CLASSES(INIT, A_ERROR),
+        [C_00] = T(INIT, A_OVERRUN),                // Overrun [3]p.25
+        [C_83] = T(INIT, A_MAKE_F7),
+        [C_84] = T(INIT, A_MAKE_PRINT_SCREEN),      // Alt'd PrintScreen
+        [C_AA] = T(INIT, A_RESET),
+        [C_E0] = T(E0,   A_NONE),
+        [C_E1] = T(E1,   A_NONE),
+        [C_F0] = T(F0,   A_NONE),
+    },
+    [E0] = {    // E0-Prefixed
+        LOW_CLASSES(INIT, A_MAKE_E0),
+        HIGH_CLASSES(INIT, A_ERROR),
+        [C_12] = T(INIT,  A_NONE),                  // to be ignored
+        [C_59] = T(INIT,  A_NONE),                  // to be ignored
+        [C_7E] = T(E0_7E, A_NONE),                  // Control'd Pause
+        [C_F0] = T(E0_F0, A_NONE),
+    },
+    [F0] = {    // Break code
+        LOW_CLASSES(INIT, A_BREAK),
+        HIGH_CLASSES(INIT, A_ERROR),
+        [C_83] = T(INIT, A_BREAK_F7),
+        [C_84] = T(INIT, A_BREAK_PRINT_SCREEN),
+        [C_F0] = T(F0,   A_ERROR),                  // clear and cont.
+    },
+    [E0_F0] = { // Break code of E0-prefixed
+        LOW_CLASSES(INIT, A_BREAK_E0),
+        HIGH_CLASSES(INIT, A_ERROR),
+        [C_12] = T(INIT, A_NONE),                   // to be ignored
+        [C_59] = T(INIT, A_NONE),                   // to be ignored
+    },
+    // Pause
+    [E1]                   = { [C_14] = T(E1_14, A_NONE) },
+    [E1_14]                = { [C_77] = T(E1_14_77, A_NONE) },
+    [E1_14_77]             = { [C_E1] = T(E1_14_77_E1, A_NONE) },
+    [E1_14_77_E1]          = { [C_F0] = T(E1_14_77_E1_F0, A_NONE) },
+    [E1_14_77_E1_F0]       = { [C_14] = T(E1_14_77_E1_F0_14, A_NONE) },
+    [E1_14_77_E1_F0_14]    = { [C_F0] = T(E1_14_77_E1_F0_14_F0, A_NONE) },
+    [E1_14_77_E1_F0_14_F0] = { [C_77] = T(INIT, A_MAKE_PAUSE) },
+    // Control'd Pause
+    [E0_7E]                = { [C_E0] = T(E0_7E_E0, A_NONE) },
+    [E0_7E_E0]             = { [C_F0] = T(E0_7E_E0_F0, A_NONE) },
+    [E0_7E_E0_F0]          = { [C_7E] = T(INIT, A_MAKE_PAUSE) },
+};
+
+
+/*
+ * Scan Code Set 3
+ *
+ * Keyboard is asked for Set 3 with all keys make/break(F8) at startup and
+ * whenever it is plugged or reset(BAT code AA). Every key has one code and
+ * break code is F0 followed by it, neither prefix state machine nor Pause
+ * hack is needed. Codes are placed on matrix position of Set 2 so that
+ * keymaps work in both modes.
+ */
+static const uint8_t PROGMEM set3_position[0x90] = {
+    [0x08] = 0x76,          // Esc
+    [0x07] = 0x05,          // F1
+    [0x0F] = 0x06,          // F2
+    [0x17] = 0x04,          // F3
+    [0x1F] = 0x0C,          // F4
+    [0x27] = 0x03,          // F5
+    [0x2F] = 0x0B,          // F6
+    [0x37] = F7,            // F7
+    [0x3F] = 0x0A,          // F8
+    [0x47] = 0x01,          // F9
+    [0x4F] = 0x09,          // F10
+    [0x56] = 0x78,          // F11
+    [0x5E] = 0x07,          // F12
+    [0x57] = PRINT_SCREEN,
+    [0x5F] = 0x7E,          // ScrollLock
+    [0x62] = PAUSE,
+
+    [0x0E] = 0x0E, [0x16] = 0x16, [0x1E] = 0x1E, [0x26] = 0x26, // ` 1 2 3
+    [0x25] = 0x25, [0x2E] = 0x2E, [0x36] = 0x36, [0x3D] = 0x3D, // 4 5 6 7
+    [0x3E] = 0x3E, [0x46] = 0x46, [0x45] = 0x45, [0x4E] = 0x4E, // 8 9 0 -
+    [0x55] = 0x55, [0x66] = 0x66,                               // = BSpace
+    [0x0D] = 0x0D, [0x15] = 0x15, [0x1D] = 0x1D, [0x24] = 0x24, // Tab Q W E
+    [0x2D] = 0x2D, [0x2C] = 0x2C, [0x35] = 0x35, [0x3C] = 0x3C, // R T Y U
+    [0x43] = 0x43, [0x44] = 0x44, [0x4D] = 0x4D, [0x54] = 0x54, // I O P [
+    [0x5B] = 0x5B, [0x5C] = 0x5D,                               // ] Backslash
+    [0x14] = 0x58, [0x1C] = 0x1C, [0x1B] = 0x1B, [0x23] = 0x23, // Caps A S D
+    [0x2B] = 0x2B, [0x34] = 0x34, [0x33] = 0x33, [0x3B] = 0x3B, // F G H J
+    [0x42] = 0x42, [0x4B] = 0x4B, [0x4C] = 0x4C, [0x52] = 0x52, // K L ; '
+    [0x53] = 0x5D, [0x5A] = 0x5A,                               // ISO# Enter
+    [0x12] = 0x12, [0x13] = 0x61, [0x1A] = 0x1A, [0x22] = 0x22, // LShift ISO\ Z X
+    [0x21] = 0x21, [0x2A] = 0x2A, [0x32] = 0x32, [0x31] = 0x31, // C V B N
+    [0x3A] = 0x3A, [0x41] = 0x41, [0x49] = 0x49, [0x4A] = 0x4A, // M , . /
+    [0x59] = 0x59,                                              // RShift
+    [0x11] = 0x14, [0x8B] = 0x9F, [0x19] = 0x11, [0x29] = 0x29, // LCtrl LGui LAlt Space
+    [0x39] = 0x91, [0x8C] = 0xA7, [0x8D] = 0xAF, [0x58] = 0x94, // RAlt RGui App RCtrl
+
+    [0x67] = 0xF0, [0x6E] = 0xEC, [0x6F] = 0xFD,                // Insert Home PgUp
+    [0x64] = 0xF1, [0x65] = 0xE9, [0x6D] = 0xFA,                // Delete End PgDown
+    [0x63] = 0xF5, [0x61] = 0xEB, [0x60] = 0xF2, [0x6A] = 0xF4, // Up Left Down Right
+
+    [0x76] = 0x77, [0x77] = 0xCA, [0x7E] = 0x7C, [0x84] = 0x7B, // NumLock / * -
+    [0x6C] = 0x6C, [0x75] = 0x75, [0x7D] = 0x7D, [0x7C] = 0x79, // 7 8 9 +
+    [0x6B] = 0x6B, [0x73] = 0x73, [0x74] = 0x74,                // 4 5 6
+    [0x69] = 0x69, [0x72] = 0x72, [0x7A] = 0x7A, [0x79] = 0xDA, // 1 2 3 Enter
+    [0x70] = 0x70, [0x71] = 0x71,                               // 0 .
+};
+
+static bool set3 = false;
+
+static bool send_command(uint8_t cmd)
+{
+    return (ps2_host_send(cmd) == PS2_ACK);
+}
+
+/* Selects Scan Code Set 3 if keyboard supports, Set 2 is used otherwise */
+static void scan_code_set_init(void)
 {
+    set3 = false;
+
+    // Set 3 is confirmed by reading back current set(F0 00) since some
+    // keyboards acknowledge F0 03 without supporting it.
+    if (send_command(0xF0) && send_command(0x03) &&
+        send_command(0xF0) && send_command(0x00) &&
+        ps2_host_recv_response() == 0x03 &&
+        send_command(0xF8)) {
+        set3 = true;
+    } else if (ps2_error == PS2_ERR_NONE) {
+        // keyboard is there but refused, make sure it is in Set 2
+        send_command(0xF0);
+        send_command(0x02);
+    }
+    xprintf("Scan Code Set %u\n", set3 ? 3 : 2);
+}
 
-    // scan code reading states
-    static enum {
-        INIT,
-        F0,
-        E0,
-        E0_F0,
-        // Pause
-        E1,
-        E1_14,
-        E1_14_77,
-        E1_14_77_E1,
-        E1_14_77_E1_F0,
-        E1_14_77_E1_F0_14,
-        E1_14_77_E1_F0_14_F0,
-        // Control'd Pause
-        E0_7E,
-        E0_7E_E0,
-        E0_7E_E0_F0,
-    } state = INIT;
+/* Returns next state in upper nibble and action in lower. Matrix position
+ * of make/break is set to 'pos'. */
+static uint8_t set2_decode(uint8_t state, uint8_t code, uint8_t *pos)
+{
+    uint8_t t = pgm_read_byte(&transition[state][pgm_read_byte(&code_class[code])]);
+    switch (t & 0x0F) {
+        case A_MAKE:
+        case A_BREAK:               *pos = code;            break;
+        case A_MAKE_E0:
+        case A_BREAK_E0:            *pos = code|0x80;       break;
+        case A_MAKE_F7:
+        case A_BREAK_F7:            *pos = F7;              break;
+        case A_MAKE_PRINT_SCREEN:
+        case A_BREAK_PRINT_SCREEN:  *pos = PRINT_SCREEN;    break;
+        case A_MAKE_PAUSE:          *pos = PAUSE;           break;
+    }
+    return t;
+}
 
+static uint8_t set3_decode(uint8_t state, uint8_t code, uint8_t *pos)
+{
+    switch (code) {
+        case 0x00:  // Overrun
+            return T(INIT, A_OVERRUN);
+        case 0xAA:
+            return (state == INIT ? T(INIT, A_RESET) : T(INIT, A_ERROR));
+        case 0xF0:
+            return (state == INIT ? T(F0, A_NONE) : T(INIT, A_ERROR));
+    }
+    if (code >= sizeof(set3_position)) {
+        return T(INIT, A_ERROR);
+    }
+    *pos = pgm_read_byte(&set3_position[code]);
+    if (!*pos) {
+        return T(INIT, A_NONE);     // keys not on 101/104 keyboard
+    }
+    return T(INIT, (state == F0 ? A_BREAK : A_MAKE));
+}
+
+
+/*
+ * Codes are decoded until a key changes so that prefix codes of a sequence
+ * don't take scans of their own. keyboard_task() processes one change per
+ * call and a second change in the same scan could be undone by next scan
+ * before it is seen(quick tap, Pause pseudo break), so the rest of codes
+ * are left in receive buffer for next scan.
+ *
+ * Decodes 'max' codes at most and returns true when scan is complete, that
+ * is, matrix is changed or receive buffer is empty.
+ */
+static bool decode(uint8_t max)
+{
+    static uint8_t state = INIT;
 
     is_modified = false;
 
     // 'pseudo break code' hack
-    if (matrix_is_on(ROW(PAUSE), COL(PAUSE))) {
+    if (!set3 && matrix_is_on(ROW(PAUSE), COL(PAUSE))) {
         matrix_break(PAUSE);
+        return true;
     }
 
-    uint8_t code = ps2_host_recv();
-    if (code) xprintf("%i\r\n", code);
-    if (!ps2_error) {
-        switch (state) {
-            case INIT:
-                switch (code) {
-                    case 0xE0:
-                        state = E0;
-                        break;
-                    case 0xF0:
-                        state = F0;
-                        break;
-                    case 0xE1:
-                        state = E1;
-                        break;
-                    case 0x83:  // F7
-                        matrix_make(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_make(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    case 0x00:  // Overrun [3]p.25
-                        matrix_clear();
-                        clear_keyboard();
-                        print("Overrun\n");
-                        state = INIT;
-                        break;
-                    default:    // normal key make
-                        if (code < 0x80) {
-                            matrix_make(code);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at INIT: %02X\n", code);
-                        }
-                        state = INIT;
-                }
-                break;
-            case E0:    // E0-Prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    case 0x7E:  // Control'd Pause
-                        state = E0_7E;
-                        break;
-                    case 0xF0:
-                        state = E0_F0;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_make(code|0x80);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at E0: %02X\n", code);
-                        }
-                        state = INIT;
-                }
-                break;
-            case F0:    // Break code
-                switch (code) {
-                    case 0x83:  // F7
-                        matrix_break(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_break(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    case 0xF0:
-                        matrix_clear();
-                        clear_keyboard();
-                        xprintf("unexpected scan code at F0: F0(clear and cont.)\n");
-                        break;
-                    default:
-                    if (code < 0x80) {
-                        matrix_break(code);
-                    } else {
-                        matrix_clear();
-                        clear_keyboard();
-                        xprintf("unexpected scan code at F0: %02X\n", code);
-                    }
-                    state = INIT;
-                }
-                break;
-            case E0_F0: // Break code of E0-prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_break(code|0x80);
-                        } else {
-                            matrix_clear();
-                            clear_keyboard();
-                            xprintf("unexpected scan code at E0_F0: %02X\n", code);
-                        }
-                        state = INIT;
-                }
+    // typematic repeat doesn't modify matrix and decoding goes on
+    while (!is_modified) {
+        if (!max--) return false;
+        uint8_t code = ps2_host_recv();
+        if (ps2_error) break;
+
+        uint8_t pos = 0;
+        uint8_t t = set3 ? set3_decode(state, code, &pos) : set2_decode(state, code, &pos);
+        uint8_t action = t & 0x0F;
+        switch (action) {
+            case A_NONE:
                 break;
-            // following are states of Pause
-            case E1:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14;
-                        break;
-                    default:
-                        state = INIT;
+            case A_OVERRUN:
+            case A_ERROR:
+            case A_RESET:
+                // change of last scan has been processed already
+                matrix_clear();
+                clear_keyboard();
+                if (action == A_OVERRUN) {
+                    trace_xprintf(TRACE_SCAN_OVERRUN, 0, 0, "Overrun\n");
+                } else if (action == A_ERROR) {
+                    trace_xprintf(TRACE_SCAN_ERROR, code, state, "unexpected scan code at %u: %02X\n", state, code);
                 }
-                break;
-            case E1_14:
-                switch (code) {
-                    case 0x77:
-                        state = E1_14_77;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77:
-                switch (code) {
-                    case 0xE1:
-                        state = E1_14_77_E1;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1_F0:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14_77_E1_F0_14;
-                        break;
-                    default:
-                        state = INIT;
+                state = t >> 4;
+                if (action == A_RESET) {
+                    scan_code_set_init();
                 }
-                break;
-            case E1_14_77_E1_F0_14:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0_14_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77_E1_F0_14_F0:
-                switch (code) {
-                    case 0x77:
-                        matrix_make(PAUSE);
-                        state = INIT;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            // Following are states of Control'd Pause
-            case E0_7E:
-                if (code == 0xE0)
-                    state = E0_7E_E0;
-                else
-                    state = INIT;
-                break;
-            case E0_7E_E0:
-                if (code == 0xF0)
-                    state = E0_7E_E0_F0;
-                else
-                    state = INIT;
-                break;
-            case E0_7E_E0_F0:
-                if (code == 0x7E)
-                    matrix_make(PAUSE);
-                state = INIT;
+                return true;
+            case A_MAKE:
+            case A_MAKE_E0:
+            case A_MAKE_F7:
+            case A_MAKE_PRINT_SCREEN:
+            case A_MAKE_PAUSE:
+                matrix_make(pos);
                 break;
             default:
-                state = INIT;
+                matrix_break(pos);
         }
+        state = t >> 4;
     }
 
     // TODO: request RESEND when error occurs?
@@ -387,9 +499,22 @@ uint8_t matrix_scan(void)
         xprintf("Resend: %02X\n", ret);
     }
 */
+    return true;
+}
+
+uint8_t matrix_scan(void)
+{
+    decode(UINT8_MAX);
     return 1;
 }
 
+/* V-USB(MATRIX_SCAN_STEP): a long sequence like Pause(8 codes) is decoded
+ * in several calls so that usbPoll() runs between them. */
+bool matrix_scan_step(void)
+{
+    return decode(PS2_SCAN_STEP);
+}
+
 bool matrix_is_modified(void)
 {
     return is_modified;
@@ -18,11 +18,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/io.h>
-#include <util/delay.h>
 #include "print.h"
 #include "util.h"
 #include "matrix.h"
 #include "debug.h"
+#include "timer.h"
+#include "host.h"
+#include "led.h"
 #include "protocol/serial.h"
 
 
@@ -48,6 +50,15 @@ static uint8_t matrix[MATRIX_ROWS];
 
 static bool is_modified = false;
 
+/*
+ * Keyboard reset is retried from matrix_scan() until it answers 'FF 04',
+ * without blocking USB or waiting for the rest of response.
+ */
+#define RESET_INTERVAL  1000
+static bool reset_done = false;
+static uint16_t reset_time;
+static uint8_t response = 0;    // first byte of two byte response
+
 
 inline
 uint8_t matrix_rows(void)
@@ -72,21 +83,11 @@ void matrix_init(void)
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
 
-    // wait for keyboard coming up
-    // otherwise LED status update fails
+    // keyboard reset is sent from matrix_scan()
+    reset_done = false;
+    reset_time = timer_read() - RESET_INTERVAL;
+    response = 0;
     print("Reseting ");
-    while (1) {
-        print(".");
-        while (serial_recv());
-        serial_send(0x01);
-        _delay_ms(500);
-        if (serial_recv() == 0xFF) {
-            _delay_ms(500);
-            if (serial_recv() == 0x04)
-                break;
-        }
-    }
-    print(" Done\n");
     return;
 }
 
@@ -94,32 +95,58 @@ uint8_t matrix_scan(void)
 {
     is_modified = false;
 
-    uint8_t code;
-    code = serial_recv();
-    if (!code) return 0;
+    // wait for keyboard coming up
+    // otherwise LED status update fails
+    if (!reset_done && timer_elapsed(reset_time) >= RESET_INTERVAL) {
+        print(".");
+        while (serial_recv2() != -1);
+        serial_send(0x01);
+        reset_time = timer_read();
+        response = 0;
+    }
+
+    // 00 is a valid second byte(layout FE 00), not 'no data'
+    int16_t c = serial_recv2();
+    if (c == -1) return 0;
+    uint8_t code = c;
 
     debug_hex(code); debug(" ");
 
+    // second byte of response
+    if (response) {
+        switch (response) {
+            case 0xFF:
+                xprintf("%02X\n", code);
+                if (code == 0x04) {
+                    if (!reset_done) print(" Done\n");
+                    reset_done = true;
+                    // LED status
+                    led_set(host_keyboard_leds());
+                }
+                break;
+            case 0xFE:
+            case 0x7E:
+                xprintf("%02X\n", code);
+                break;
+        }
+        response = 0;
+        return 0;
+    }
+
     switch (code) {
+        case 0x00:
+            return 0;
         case 0xFF:  // reset success: FF 04
             print("reset: ");
-            _delay_ms(500);
-            code = serial_recv();
-            xprintf("%02X\n", code);
-            if (code == 0x04) {
-                // LED status
-                led_set(host_keyboard_leds());
-            }
+            response = code;
             return 0;
         case 0xFE:  // layout: FE <layout>
             print("layout: ");
-            _delay_ms(500);
-            xprintf("%02X\n", serial_recv());
+            response = code;
             return 0;
         case 0x7E:  // reset fail: 7E 01
             print("reset fail: ");
-            _delay_ms(500);
-            xprintf("%02X\n", serial_recv());
+            response = code;
             return 0;
         case 0x7F:
             // all keys up
@@ -1,6 +1,7 @@
 #include <avr/io.h>
 #include <avr/wdt.h>
 #include <avr/power.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 
 // USB HID host
@@ -9,6 +10,11 @@
 #include "hid.h"
 #include "hidboot.h"
 #include "parser.h"
+#ifdef USB_HID_REPORT_PROTOCOL
+#include "hidreport.h"
+#endif
+#include "usb_hid.h"
+#include "kbdpoll.h"
 
 // LUFA
 #include "lufa.h"
@@ -69,15 +75,180 @@ static void LUFA_setup(void)
  */
 USB usb_host;
 USBHub hub1(&usb_host);
-HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd(&usb_host);
-KBDReportParser kbd_parser;
+
+#ifdef USB_HID_REPORT_PROTOCOL
+typedef HIDReportKeyboard   Keyboard;
+#else
+typedef HIDBootKeyboard     Keyboard;
+#endif
+
+/* one instance per keyboard behind hub */
+#if USB_HID_KEYBOARD_COUNT > 4
+#   error "USB_HID_KEYBOARD_COUNT: 4 keyboards at most"
+#endif
+Keyboard kbd1(&usb_host, 0);
+#if USB_HID_KEYBOARD_COUNT > 1
+Keyboard kbd2(&usb_host, 1);
+#endif
+#if USB_HID_KEYBOARD_COUNT > 2
+Keyboard kbd3(&usb_host, 2);
+#endif
+#if USB_HID_KEYBOARD_COUNT > 3
+Keyboard kbd4(&usb_host, 3);
+#endif
+
+static Keyboard *const kbd[USB_HID_KEYBOARD_COUNT] = {
+    &kbd1,
+#if USB_HID_KEYBOARD_COUNT > 1
+    &kbd2,
+#endif
+#if USB_HID_KEYBOARD_COUNT > 2
+    &kbd3,
+#endif
+#if USB_HID_KEYBOARD_COUNT > 3
+    &kbd4,
+#endif
+};
 
 
 void led_set(uint8_t usb_led)
 {
-    kbd.SetReport(0, 0, 2, 0, 1, &usb_led);
+#ifdef USB_HOST_INT
+    // control request can't be sent while IN transfer is on the bus
+    while (kbd_xfer_owner != KBD_XFER_NONE) {
+        kbd[kbd_xfer_owner]->XferTask();
+    }
+#endif
+    for (uint8_t i = 0; i < USB_HID_KEYBOARD_COUNT; i++) {
+        if (kbd[i]->isReady()) {
+            kbd[i]->SetReport(0, 0, 2, 0, 1, &usb_led);
+        }
+    }
+}
+
+
+
+#ifdef USB_HOST_INT
+/*
+ * MAX3421E INT driven host task
+ *
+ * usb_host.Task() reads HIRQ via SPI whenever INT pin is asserted and SOF
+ * interrupt keeps INT asserted all the time, so the task touches SPI on
+ * every loop. In this mode INT is asserted only on connect/disconnect and
+ * transfer done(HXFRDN). The task runs only when INT is asserted, during
+ * enumeration, when a keyboard is due to poll or every
+ * USB_HOST_TASK_INTERVAL for hub.
+ *
+ * Keyboard IN transfers are split-phase: Poll() launches IN token and
+ * returns, and result and data are read on HXFRDN/RCVDAV. Nothing else is
+ * run on the host side while the transfer is on the bus. hub1 is
+ * registered before keyboards, so its blocking Poll() is done before a
+ * keyboard launches transfer in the same Task() pass.
+ */
+#ifndef USB_HID_REPORT_PROTOCOL
+#   error "USB_HOST_INT: USB_HID_REPORT_PROTOCOL is required"
+#endif
+#ifndef USB_HOST_TASK_INTERVAL
+#define USB_HOST_TASK_INTERVAL  10
+#endif
+
+// INT on D9(PB5, PCINT5) of Leonardo
+#define HOST_INT_INIT()     do { PCMSK0 |= (1<<PCINT5); PCICR |= (1<<PCIE0); } while (0)
+#define HOST_INT_ASSERTED() (!(PINB & (1<<PB5)))
+
+static volatile bool host_int = false;
+
+ISR(PCINT0_vect)
+{
+    host_int = true;
 }
 
+static void host_int_init(void)
+{
+    usb_host.regWr(rHIEN, bmCONDETIE | bmHXFRDNIE);
+    usb_host.regWr(rHIRQ, bmFRAMEIRQ);
+    HOST_INT_INIT();
+}
+
+static bool host_task_needed(void)
+{
+    static uint16_t last = 0;
+
+    if (kbd_xfer_owner != KBD_XFER_NONE) {
+        // transfer done, or device gone without HXFRDN
+        if (host_int || HOST_INT_ASSERTED() || kbd_xfer_expired()) {
+            host_int = false;
+            return true;
+        }
+        return false;
+    }
+
+    if (host_int || HOST_INT_ASSERTED() ||
+            usb_host.getUsbTaskState() != USB_STATE_RUNNING ||
+            kbd_poll_pending() ||
+            timer_elapsed(last) >= USB_HOST_TASK_INTERVAL) {
+        host_int = false;
+        last = timer_read();
+        return true;
+    }
+    return false;
+}
+#endif
+
+
+#ifdef USB_HOST_TASK_STATS
+/*
+ * Host task cost per second in Timer0 ticks(TIMER_RAW_FREQ)
+ */
+static uint32_t host_ticks(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ms = timer_count;
+    uint8_t raw = TIMER_RAW;
+    if ((TIFR0 & (1<<OCF0A)) && raw < TIMER_RAW_TOP/2) ms++;
+    SREG = sreg;
+    return ms * TIMER_RAW_TOP + raw;
+}
+
+static void host_task_stats(uint32_t ticks)
+{
+    static uint16_t last = 0;
+    static uint16_t calls = 0;
+    static uint32_t total = 0;
+    static uint32_t max = 0;
+
+    calls++;
+    total += ticks;
+    if (ticks > max) max = ticks;
+
+    if (timer_elapsed(last) >= 1000) {
+        xprintf("host task: calls:%u total:%luus max:%luus\n", calls,
+                total * 1000 / TIMER_RAW_TOP, max * 1000 / TIMER_RAW_TOP);
+        last = timer_read();
+        calls = 0;
+        total = 0;
+        max = 0;
+    }
+}
+#endif
+
+
+/* Completes keyboard IN transfer on the bus, or runs USB::Task() */
+static void host_task(void)
+{
+#ifdef USB_HOST_INT
+    if (kbd_xfer_owner != KBD_XFER_NONE) {
+        kbd[kbd_xfer_owner]->XferTask();
+        return;
+    }
+    usb_host.Task();
+    // HXFRDN edges of transfers done in Task(), pending IRQs still hold INT
+    host_int = false;
+#else
+    usb_host.Task();
+#endif
+}
 
 
 int main(void)
@@ -96,7 +267,9 @@ int main(void)
 
     // USB Host Shield setup
     usb_host.Init();
-    kbd.SetReportParser(0, (HIDReportParser*)&kbd_parser);
+#ifdef USB_HOST_INT
+    host_int_init();
+#endif
 
     /* NOTE: Don't insert time consuming job here.
      * It'll cause unclear initialization failure when DFU reset(worm start).
@@ -111,16 +284,21 @@ int main(void)
 
     debug("init: done\n");
 
-uint16_t timer;
     for (;;) {
         keyboard_task();
 
-timer = timer_read();
-        usb_host.Task();
-timer = timer_elapsed(timer);
-if (timer > 100) {
-    debug("host.Task: "); debug_hex16(timer);  debug("\n");
-}
+#ifdef USB_HOST_INT
+        if (host_task_needed())
+#endif
+        {
+#ifdef USB_HOST_TASK_STATS
+            uint32_t t = host_ticks();
+            host_task();
+            host_task_stats(host_ticks() - t);
+#else
+            host_task();
+#endif
+        }
 
 #if !defined(INTERRUPT_CONTROL_ENDPOINT)
         // LUFA Task for control request
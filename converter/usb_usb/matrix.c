@@ -56,11 +56,29 @@ bool matrix_has_ghost(void) { return false; }
 
 static bool matrix_is_mod =false;
 
+/* matrix state merged from usb_hid_keyboard_bits of all keyboards
+ * Updated only when a new report arrives so that row reads are plain loads.
+ */
+static matrix_row_t matrix[MATRIX_ROWS];
+
+static void matrix_update(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        uint8_t lo = 0, hi = 0;
+        for (uint8_t k = 0; k < USB_HID_KEYBOARD_COUNT; k++) {
+            lo |= usb_hid_keyboard_bits[k][row * 2];
+            hi |= usb_hid_keyboard_bits[k][row * 2 + 1];
+        }
+        matrix[row] = lo | (matrix_row_t)hi << 8;
+    }
+}
+
 uint8_t matrix_scan(void) {
     static uint16_t last_time_stamp = 0;
 
     if (last_time_stamp != usb_hid_time_stamp) {
         last_time_stamp = usb_hid_time_stamp;
+        matrix_update();
         matrix_is_mod = true;
     } else {
         matrix_is_mod = false;
@@ -74,46 +92,17 @@ bool matrix_is_modified(void) {
 }
 
 bool matrix_is_on(uint8_t row, uint8_t col) {
-    uint8_t code = CODE(row, col);
-
-    if (IS_MOD(code)) {
-        if (usb_hid_keyboard_report.mods & ROW_BITS(code)) {
-            return true;
-        }
-    }
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (usb_hid_keyboard_report.keys[i] == code) {
-            return true;
-        }
-    }
-    return false;
+    return (matrix[row] & ((matrix_row_t)1<<col));
 }
 
 matrix_row_t matrix_get_row(uint8_t row) {
-    uint16_t row_bits = 0;
-
-    if (IS_MOD(CODE(row, 0)) && usb_hid_keyboard_report.mods) {
-        row_bits |= usb_hid_keyboard_report.mods;
-    }
-
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (IS_ANY(usb_hid_keyboard_report.keys[i])) {
-            if (row == ROW(usb_hid_keyboard_report.keys[i])) {
-                row_bits |= ROW_BITS(usb_hid_keyboard_report.keys[i]);
-            }
-        }
-    }
-    return row_bits;
+    return matrix[row];
 }
 
 uint8_t matrix_key_count(void) {
     uint8_t count = 0;
-
-    count += bitpop(usb_hid_keyboard_report.mods);
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (IS_ANY(usb_hid_keyboard_report.keys[i])) {
-            count++;
-        }
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        count += bitpop16(matrix[row]);
     }
     return count;
 }
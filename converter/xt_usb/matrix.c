@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "util.h"
 #include "debug.h"
+#include "trace.h"
 #include "xt.h"
 #include "matrix.h"
 
@@ -151,10 +152,10 @@ uint8_t matrix_scan(void)
                     break;
                 default:    // normal key make
                     if (code < 0x80 && code != 0x00) {
-                        xprintf("make: %X\r\n", code);
+                        trace_xprintf(TRACE_SCAN_CODE, code, state, "make: %X\r\n", code);
                         matrix_make(code);
                     } else if (code > 0x80 && code < 0xFF && code != 0x00) {
-                        xprintf("break %X\r\n", code);
+                        trace_xprintf(TRACE_SCAN_CODE, code, state, "break %X\r\n", code);
                         matrix_break(code - 0x80);
                     }
                     state = INIT;
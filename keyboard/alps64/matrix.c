@@ -198,3 +198,17 @@ static void select_row(uint8_t row)
             break;
     }
 }
+
+/* Suspend: all rows low, key press wakes MCU with pin change on column */
+void matrix_wakeup_select(void)
+{
+    DDRD  |=  0b01111111;
+    PORTD &= ~0b01111111;
+    DDRC  |=  0b00000100;
+    PORTC &= ~0b00000100;
+}
+
+void matrix_wakeup_unselect(void)
+{
+    unselect_rows();
+}
@@ -50,12 +50,17 @@ Project located at <https://github.com/benblazak/ergodox-firmware>
  * scan loops which should be made to get stable debounced results.
  *
  * On Ergodox matrix scan rate is relatively low, because of slow I2C.
- * Now it's only 317 scans/second, or about 3.15 msec/scan.
+ * It was only 317 scans/second, or about 3.15 msec/scan, with three
+ * transactions per left row. Now a left row takes one 5-byte transaction,
+ * scan rate of this has not been measured yet; see DEBUG_MATRIX_SCAN_RATE.
  * According to Cherry specs, debouncing time is 5 msec.
  *
  * And so, there is no sense to have DEBOUNCE higher than 2.
  */
 #define DEBOUNCE        2
+
+/* I2C to left half: 444kHz at 16MHz, MCP23018 runs up to 3.4MHz */
+#define TWI_TWBR        10
 #define TAPPING_TERM    230
 
 /* Mechanical locking support. Use KC_LCAP, KC_LNUM or KC_LSCR instead in keymap */
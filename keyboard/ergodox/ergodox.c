@@ -35,15 +35,20 @@ Most used files are located at
 #include "print.h"
 #include "debug.h"
 #include "ergodox.h"
-#include "i2cmaster.h"
+#include "twi.h"
 
-bool i2c_initialized = 0;
+static bool twi_initialized = false;
 uint8_t mcp23018_status = 0x20;
 
 bool ergodox_left_led_1 = 0;  // left top
 bool ergodox_left_led_2 = 0;  // left middle
 bool ergodox_left_led_3 = 0;  // left bottom
 
+// last LED state written to MCP23018
+static bool left_leds_sent = false;
+static uint8_t left_olata;
+static uint8_t left_olatb;
+
 
 void init_ergodox(void)
 {
@@ -74,43 +79,51 @@ void ergodox_blink_all_leds(void)
     ergodox_led_all_off();
 }
 
+/* Writes registers from buf[0] with data in rest of buf */
+static uint8_t mcp23018_write(uint8_t *buf, uint8_t len)
+{
+    twi_msg_t msg = { I2C_ADDR, TWI_WRITE, len, buf };
+    return twi_transfer(&msg, 1);
+}
+
 uint8_t init_mcp23018(void) {
     mcp23018_status = 0x20;
 
     // I2C subsystem
-    if (i2c_initialized == 0) {
-        i2c_init();  // on pins D(1,0)
-        i2c_initialized++;
+    if (!twi_initialized) {
+        twi_init();  // on pins D(1,0)
+        twi_initialized = true;
         _delay_ms(1000);
     }
 
+    // byte mode: address pointer toggles between A and B register
+    // instead of incrementing, see matrix.c
+    uint8_t iocon[] = { IOCON, IOCON_SEQOP };
+
     // set pin direction
     // - unused  : input  : 1
     // - input   : input  : 1
     // - driving : output : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(IODIRA);            if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
-    i2c_stop();
+    uint8_t iodir[] = { IODIRA, 0b00000000, 0b00111111 };
 
     // set pull-up
     // - unused  : on  : 1
     // - input   : on  : 1
     // - driving : off : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(GPPUA);             if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
+    uint8_t gppu[] = { GPPUA, 0b00000000, 0b00111111 };
 
-out:
-    i2c_stop();
+    mcp23018_status = mcp23018_write(iocon, sizeof(iocon));    if (mcp23018_status) goto out;
+    mcp23018_status = mcp23018_write(iodir, sizeof(iodir));    if (mcp23018_status) goto out;
+    mcp23018_status = mcp23018_write(gppu, sizeof(gppu));      if (mcp23018_status) goto out;
 
+out:
+    left_leds_sent = false;
     if (!mcp23018_status) mcp23018_status = ergodox_left_leds_update();
 
     return mcp23018_status;
 }
 
+/* Written only on change */
 uint8_t ergodox_left_leds_update(void) {
     if (mcp23018_status) { // if there was an error
         return mcp23018_status;
@@ -120,17 +133,21 @@ uint8_t ergodox_left_leds_update(void) {
     // - unused  : hi-Z : 1
     // - input   : hi-Z : 1
     // - driving : hi-Z : 1
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(OLATA);             if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b11111111
-            & ~(ergodox_left_led_3<<LEFT_LED_3_SHIFT)
-          );                                        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b11111111
+    uint8_t olata = 0b11111111
+            & ~(ergodox_left_led_3<<LEFT_LED_3_SHIFT);
+    uint8_t olatb = 0b11111111
             & ~(ergodox_left_led_2<<LEFT_LED_2_SHIFT)
-            & ~(ergodox_left_led_1<<LEFT_LED_1_SHIFT)
-          );                                        if (mcp23018_status) goto out;
+            & ~(ergodox_left_led_1<<LEFT_LED_1_SHIFT);
+    if (left_leds_sent && olata == left_olata && olatb == left_olatb) {
+        return mcp23018_status;
+    }
 
-out:
-    i2c_stop();
+    uint8_t olat[] = { OLATA, olata, olatb };
+    mcp23018_status = mcp23018_write(olat, sizeof(olat));
+    if (!mcp23018_status) {
+        left_olata = olata;
+        left_olatb = olatb;
+        left_leds_sent = true;
+    }
     return mcp23018_status;
 }
@@ -27,16 +27,16 @@ Most used files are located at
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/io.h>
-#include "i2cmaster.h"
+#include "twi.h"
 
 #define CPU_PRESCALE(n) (CLKPR = 0x80, CLKPR = (n))
 #define CPU_16MHz       0x00
 
 // I2C aliases and register addresses (see "mcp23018.md")
 #define I2C_ADDR        0b0100000
-#define I2C_ADDR_WRITE  ( (I2C_ADDR<<1) | I2C_WRITE )
-#define I2C_ADDR_READ   ( (I2C_ADDR<<1) | I2C_READ  )
 #define IODIRA          0x00            // i/o direction register
+#define IOCON           0x0A            // configuration register
+#define IOCON_SEQOP     (1<<5)          // byte mode: address pointer toggles A/B
 #define IODIRB          0x01
 #define GPPUA           0x0C            // GPIO pull-up resistor register
 #define GPPUB           0x0D
@@ -28,7 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "matrix.h"
 #include "ergodox.h"
-#include "i2cmaster.h"
+#include "twi.h"
 #ifdef DEBUG_MATRIX_SCAN_RATE
 #include  "timer.h"
 #endif
@@ -46,6 +46,10 @@ static matrix_row_t read_cols(uint8_t row);
 static void init_cols(void);
 static void unselect_rows(void);
 static void select_row(uint8_t row);
+static void left_select(uint8_t row);
+static void left_start(uint8_t next);
+static matrix_row_t left_finish(void);
+static void debounce_row(uint8_t row, matrix_row_t cols);
 
 static uint8_t mcp23018_reset_loop;
 
@@ -166,17 +170,20 @@ uint8_t matrix_scan(void)
     mcp23018_status = ergodox_left_leds_update();
 #endif
 
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        select_row(i);
-        matrix_row_t cols = read_cols(i);
-        if (matrix_debouncing[i] != cols) {
-            matrix_debouncing[i] = cols;
-            if (debouncing) {
-                debug("bounce!: "); debug_hex(debouncing); debug("\n");
-            }
-            debouncing = DEBOUNCE;
-        }
+    /*
+     * Left row selected at end of a transaction settles in the 30us wait of
+     * right row scan and is read by next transaction. Right row is compared
+     * with debouncing state while the transaction runs in TWI interrupt.
+     */
+    left_select(0);
+    for (uint8_t i = 0; i < 7; i++) {
+        select_row(7 + i);
+        matrix_row_t cols = read_cols(7 + i);
         unselect_rows();
+
+        left_start(i + 1);
+        debounce_row(7 + i, cols);
+        debounce_row(i, left_finish());
     }
 
     if (debouncing) {
@@ -192,6 +199,17 @@ uint8_t matrix_scan(void)
     return 1;
 }
 
+static void debounce_row(uint8_t row, matrix_row_t cols)
+{
+    if (matrix_debouncing[row] != cols) {
+        matrix_debouncing[row] = cols;
+        if (debouncing) {
+            debug("bounce!: "); debug_hex(debouncing); debug("\n");
+        }
+        debouncing = DEBOUNCE;
+    }
+}
+
 bool matrix_is_modified(void)
 {
     if (debouncing) return false;
@@ -250,33 +268,70 @@ static void  init_cols(void)
     PORTF |=  (1<<7 | 1<<6 | 1<<5 | 1<<4 | 1<<1 | 1<<0);
 }
 
+/* Teensy rows only; left rows are read with left_start()/left_finish() */
 static matrix_row_t read_cols(uint8_t row)
 {
-    if (row < 7) {
-        if (mcp23018_status) { // if there was an error
-            return 0;
-        } else {
-            uint8_t data = 0;
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOB);             if (mcp23018_status) goto out;
-            mcp23018_status = i2c_start(I2C_ADDR_READ);     if (mcp23018_status) goto out;
-            data = i2c_readNak();
-            data = ~data;
-        out:
-            i2c_stop();
-            return data;
-        }
-    } else {
-        _delay_us(30);  // without this wait read unstable value.
-        // read from teensy
-        return
-            (PINF&(1<<0) ? 0 : (1<<0)) |
-            (PINF&(1<<1) ? 0 : (1<<1)) |
-            (PINF&(1<<4) ? 0 : (1<<2)) |
-            (PINF&(1<<5) ? 0 : (1<<3)) |
-            (PINF&(1<<6) ? 0 : (1<<4)) |
-            (PINF&(1<<7) ? 0 : (1<<5)) ;
-    }
+    _delay_us(30);  // without this wait read unstable value.
+    // read from teensy
+    return
+        (PINF&(1<<0) ? 0 : (1<<0)) |
+        (PINF&(1<<1) ? 0 : (1<<1)) |
+        (PINF&(1<<4) ? 0 : (1<<2)) |
+        (PINF&(1<<5) ? 0 : (1<<3)) |
+        (PINF&(1<<6) ? 0 : (1<<4)) |
+        (PINF&(1<<7) ? 0 : (1<<5)) ;
+}
+
+/* Left half(MCP23018)
+ *
+ * MCP23018 is in byte mode(IOCON.SEQOP=1), where address pointer toggles
+ * between GPIOA and GPIOB. Write of row select to GPIOA leaves the pointer
+ * at GPIOB, so that columns are read without register address and next row
+ * is selected in one transaction:
+ *
+ *   S <R> <GPIOB> Sr <W> GPIOA <row select> P
+ *
+ * This is 5 bytes and a transaction per row instead of 10 bytes and three.
+ */
+static uint8_t left_cols;
+static uint8_t left_sel[2] = { GPIOA, 0xFF };
+static const twi_msg_t left_msgs[] = {
+    { I2C_ADDR, TWI_READ,  1, &left_cols },
+    { I2C_ADDR, TWI_WRITE, 2, left_sel },
+};
+
+static uint8_t left_row_bits(uint8_t row)
+{
+    // set active row low  : 0
+    // set other rows hi-Z : 1
+    // row 7: all rows hi-Z
+    return 0xFF & ~(row < 7 ? 1<<row : 0)
+                & ~(ergodox_left_led_3<<LEFT_LED_3_SHIFT);
+}
+
+static void left_select(uint8_t row)
+{
+    if (mcp23018_status) return;
+
+    left_sel[1] = left_row_bits(row);
+    mcp23018_status = twi_transfer(&left_msgs[1], 1);
+}
+
+/* Reads selected row and selects next in background */
+static void left_start(uint8_t next)
+{
+    if (mcp23018_status) return;
+
+    left_sel[1] = left_row_bits(next);
+    if (!twi_start(left_msgs, 2)) mcp23018_status = TWI_BUSY;
+}
+
+static matrix_row_t left_finish(void)
+{
+    if (mcp23018_status) return 0;
+
+    mcp23018_status = twi_wait();
+    return mcp23018_status ? 0 : (uint8_t)~left_cols;
 }
 
 /* Row pin configuration
@@ -291,20 +346,6 @@ static matrix_row_t read_cols(uint8_t row)
  */
 static void unselect_rows(void)
 {
-    // unselect on mcp23018
-    if (mcp23018_status) { // if there was an error
-        // do nothing
-    } else {
-        // set all rows hi-Z : 1
-        mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write(GPIOA);             if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write( 0xFF
-                              & ~(ergodox_left_led_3<<LEFT_LED_3_SHIFT)
-                          );                            if (mcp23018_status) goto out;
-    out:
-        i2c_stop();
-    }
-
     // unselect on teensy
     // Hi-Z(DDR:0, PORT:0) to unselect
     DDRB  &= ~(1<<0 | 1<<1 | 1<<2 | 1<<3);
@@ -317,53 +358,36 @@ static void unselect_rows(void)
 
 static void select_row(uint8_t row)
 {
-    if (row < 7) {
-        // select on mcp23018
-        if (mcp23018_status) { // if there was an error
-            // do nothing
-        } else {
-            // set active row low  : 0
-            // set other rows hi-Z : 1
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOA);                 if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write( 0xFF & ~(1<<row)
-                                  & ~(ergodox_left_led_3<<LEFT_LED_3_SHIFT)
-                              );                                if (mcp23018_status) goto out;
-        out:
-            i2c_stop();
-        }
-    } else {
-        // select on teensy
-        // Output low(DDR:1, PORT:0) to select
-        switch (row) {
-            case 7:
-                DDRB  |= (1<<0);
-                PORTB &= ~(1<<0);
-                break;
-            case 8:
-                DDRB  |= (1<<1);
-                PORTB &= ~(1<<1);
-                break;
-            case 9:
-                DDRB  |= (1<<2);
-                PORTB &= ~(1<<2);
-                break;
-            case 10:
-                DDRB  |= (1<<3);
-                PORTB &= ~(1<<3);
-                break;
-            case 11:
-                DDRD  |= (1<<2);
-                PORTD &= ~(1<<3);
-                break;
-            case 12:
-                DDRD  |= (1<<3);
-                PORTD &= ~(1<<3);
-                break;
-            case 13:
-                DDRC  |= (1<<6);
-                PORTC &= ~(1<<6);
-                break;
-        }
+    // select on teensy
+    // Output low(DDR:1, PORT:0) to select
+    switch (row) {
+        case 7:
+            DDRB  |= (1<<0);
+            PORTB &= ~(1<<0);
+            break;
+        case 8:
+            DDRB  |= (1<<1);
+            PORTB &= ~(1<<1);
+            break;
+        case 9:
+            DDRB  |= (1<<2);
+            PORTB &= ~(1<<2);
+            break;
+        case 10:
+            DDRB  |= (1<<3);
+            PORTB &= ~(1<<3);
+            break;
+        case 11:
+            DDRD  |= (1<<2);
+            PORTD &= ~(1<<3);
+            break;
+        case 12:
+            DDRD  |= (1<<3);
+            PORTD &= ~(1<<3);
+            break;
+        case 13:
+            DDRC  |= (1<<6);
+            PORTC &= ~(1<<6);
+            break;
     }
 }
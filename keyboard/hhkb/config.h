@@ -36,6 +36,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MATRIX_COLS 8
 
 
+/* Measure KEY_STATE settle and recovery time at startup instead of fixed
+ * worst case delays, see matrix.c */
+//#define HHKB_SCAN_CALIBRATE
+/* Scan rows changed in last N ms again between full scans */
+//#define HHKB_SCAN_HOT_TIME      100
+
+
 /* key combination for command */
 #define IS_COMMAND() (keyboard_report->mods == (MOD_BIT(KC_LSHIFT) | MOD_BIT(KC_RSHIFT))) 
 
@@ -42,6 +42,51 @@ static matrix_row_t *matrix_prev;
 static matrix_row_t _matrix0[MATRIX_ROWS];
 static matrix_row_t _matrix1[MATRIX_ROWS];
 
+// KEY_STATE returns to idle state in this time after KEY_UNABLE
+#ifdef HHKB_JP
+// Looks like JP needs faster scan due to its twice larger matrix
+// or it can drop keys in fast key typing
+#   define RECOVER_US   30
+#else
+#   define RECOVER_US   75
+#endif
+#define SETTLE_US       5
+
+#ifdef HHKB_SCAN_CALIBRATE
+/*
+ * Calibrated scan timing
+ *
+ * Safe delays vary between controllers and clocks(see notes in
+ * matrix_scan()). KEY_STATE of a pressed key is sampled in tight loop after
+ * KEY_ENABLE and after KEY_UNABLE. The loop is timed with TIMER_RAW at
+ * startup and the longest time until KEY_STATE stops changing plus margin
+ * is used instead of the fixed delays. Released key shows no transition, so
+ * keys pressed at startup or else first keys pressed afterwards are
+ * measured, and fixed delays are used until then. Delays never exceed the
+ * fixed ones and recovery is at least 25us.
+ */
+#define CAL_PASSES      4
+#define CAL_KEYS        16      // keys measured after startup
+#define CAL_MARGIN      2       // us
+#define RECOVER_MIN     25
+static uint8_t settle_us = SETTLE_US;
+static uint8_t recover_us = RECOVER_US;
+static uint8_t per16;           // time of a sample in 1/16us
+static uint8_t settle_n, recover_n;
+static uint8_t cal_settle = 0, cal_recover = 0;
+static uint8_t cal_keys = CAL_KEYS;
+static void delay_us(uint8_t us);
+static void matrix_calibrate(void);
+static void calibrate_task(void);
+#endif
+
+#ifdef HHKB_SCAN_HOT_TIME
+// rows changed in last HHKB_SCAN_HOT_TIME ms are scanned again between full scans
+static uint16_t hot_rows = 0;
+static uint16_t hot_time = 0;
+static bool hot_scan = false;
+#endif
+
 
 inline
 uint8_t matrix_rows(void)
@@ -69,80 +114,81 @@ void matrix_init(void)
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix1[i] = 0x00;
     matrix = _matrix0;
     matrix_prev = _matrix1;
+
+#ifdef HHKB_SCAN_CALIBRATE
+    matrix_calibrate();
+#endif
 }
 
-uint8_t matrix_scan(void)
+/* Reads a row, 'last' is its previous state for hysteresis control */
+static matrix_row_t read_row(uint8_t row, matrix_row_t last)
 {
-    uint8_t *tmp;
+    matrix_row_t data = last;
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        KEY_SELECT(row, col);
+        _delay_us(5);
 
-    tmp = matrix_prev;
-    matrix_prev = matrix;
-    matrix = tmp;
+        // Not sure this is needed. This just emulates HHKB controller's behaviour.
+        if (last & (1<<col)) {
+            KEY_PREV_ON();
+        }
+        _delay_us(10);
 
-    // power on
-    if (!KEY_POWER_STATE()) KEY_POWER_ON();
-    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
-        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
-            KEY_SELECT(row, col);
-            _delay_us(5);
+        // NOTE: KEY_STATE is valid only in 20us after KEY_ENABLE.
+        // If V-USB interrupts in this section we could lose 40us or so
+        // and would read invalid value from KEY_STATE.
+        uint8_t start = TIMER_RAW;
 
-            // Not sure this is needed. This just emulates HHKB controller's behaviour.
-            if (matrix_prev[row] & (1<<col)) {
-                KEY_PREV_ON();
-            }
-            _delay_us(10);
-
-            // NOTE: KEY_STATE is valid only in 20us after KEY_ENABLE.
-            // If V-USB interrupts in this section we could lose 40us or so
-            // and would read invalid value from KEY_STATE.
-            uint8_t last = TIMER_RAW;
-
-            KEY_ENABLE();
-
-            // Wait for KEY_STATE outputs its value.
-            // 1us was ok on one HHKB, but not worked on another.
-            // no   wait doesn't work on Teensy++ with pro(1us works)
-            // no   wait does    work on tmk PCB(8MHz) with pro2
-            // 1us  wait does    work on both of above
-            // 1us  wait doesn't work on tmk(16MHz)
-            // 5us  wait does    work on tmk(16MHz)
-            // 5us  wait does    work on tmk(16MHz/2)
-            // 5us  wait does    work on tmk(8MHz)
-            // 10us wait does    work on Teensy++ with pro
-            // 10us wait does    work on 328p+iwrap with pro
-            // 10us wait doesn't work on tmk PCB(8MHz) with pro2(very lagged scan)
-            _delay_us(5);
-
-            if (KEY_STATE()) {
-                matrix[row] &= ~(1<<col);
-            } else {
-                matrix[row] |= (1<<col);
-            }
+        KEY_ENABLE();
 
-            // Ignore if this code region execution time elapses more than 20us.
-            // MEMO: 20[us] * (TIMER_RAW_FREQ / 1000000)[count per us]
-            // MEMO: then change above using this rule: a/(b/c) = a*1/(b/c) = a*(c/b)
-            if (TIMER_DIFF_RAW(TIMER_RAW, last) > 20/(1000000/TIMER_RAW_FREQ)) {
-                matrix[row] = matrix_prev[row];
-            }
+        // Wait for KEY_STATE outputs its value.
+        // 1us was ok on one HHKB, but not worked on another.
+        // no   wait doesn't work on Teensy++ with pro(1us works)
+        // no   wait does    work on tmk PCB(8MHz) with pro2
+        // 1us  wait does    work on both of above
+        // 1us  wait doesn't work on tmk(16MHz)
+        // 5us  wait does    work on tmk(16MHz)
+        // 5us  wait does    work on tmk(16MHz/2)
+        // 5us  wait does    work on tmk(8MHz)
+        // 10us wait does    work on Teensy++ with pro
+        // 10us wait does    work on 328p+iwrap with pro
+        // 10us wait doesn't work on tmk PCB(8MHz) with pro2(very lagged scan)
+#ifdef HHKB_SCAN_CALIBRATE
+        delay_us(settle_us);
+#else
+        _delay_us(SETTLE_US);
+#endif
 
-            _delay_us(5);
-            KEY_PREV_OFF();
-            KEY_UNABLE();
+        if (KEY_STATE()) {
+            data &= ~(1<<col);
+        } else {
+            data |= (1<<col);
+        }
 
-            // NOTE: KEY_STATE keep its state in 20us after KEY_ENABLE.
-            // This takes 25us or more to make sure KEY_STATE returns to idle state.
-#ifdef HHKB_JP
-            // Looks like JP needs faster scan due to its twice larger matrix
-            // or it can drop keys in fast key typing
-            _delay_us(30);
+        // Ignore if this code region execution time elapses more than 20us.
+        // MEMO: 20[us] * (TIMER_RAW_FREQ / 1000000)[count per us]
+        // MEMO: then change above using this rule: a/(b/c) = a*1/(b/c) = a*(c/b)
+        if (TIMER_DIFF_RAW(TIMER_RAW, start) > 20/(1000000/TIMER_RAW_FREQ)) {
+            data = last;
+        }
+
+        _delay_us(5);
+        KEY_PREV_OFF();
+        KEY_UNABLE();
+
+        // NOTE: KEY_STATE keep its state in 20us after KEY_ENABLE.
+        // This takes 25us or more to make sure KEY_STATE returns to idle state.
+#ifdef HHKB_SCAN_CALIBRATE
+        delay_us(recover_us);
 #else
-            _delay_us(75);
+        _delay_us(RECOVER_US);
 #endif
-        }
-        if (matrix[row] ^ matrix_prev[row]) matrix_last_modified = timer_read32();
     }
-    // power off
+    return data;
+}
+
+static void power_save(void)
+{
     if (KEY_POWER_STATE() &&
             (USB_DeviceState == DEVICE_STATE_Suspended ||
              USB_DeviceState == DEVICE_STATE_Unattached ) &&
@@ -150,9 +196,73 @@ uint8_t matrix_scan(void)
         KEY_POWER_OFF();
         suspend_power_down();
     }
+}
+
+uint8_t matrix_scan(void)
+{
+    uint8_t *tmp;
+
+    tmp = matrix_prev;
+    matrix_prev = matrix;
+    matrix = tmp;
+
+    uint16_t scan_rows = 0xFFFF;
+#ifdef HHKB_SCAN_HOT_TIME
+    if (hot_rows && timer_elapsed(hot_time) > HHKB_SCAN_HOT_TIME) hot_rows = 0;
+    hot_scan = !hot_scan && hot_rows;
+    if (hot_scan) scan_rows = hot_rows;
+#endif
+
+    // power on
+    if (!KEY_POWER_STATE()) KEY_POWER_ON();
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        if (!(scan_rows & ((uint16_t)1<<row))) {
+            matrix[row] = matrix_prev[row];
+            continue;
+        }
+        matrix[row] = read_row(row, matrix_prev[row]);
+        if (matrix[row] ^ matrix_prev[row]) {
+            matrix_last_modified = timer_read32();
+#ifdef HHKB_SCAN_HOT_TIME
+            hot_rows |= ((uint16_t)1<<row);
+            hot_time = timer_read();
+#endif
+        }
+    }
+#ifdef HHKB_SCAN_CALIBRATE
+    calibrate_task();
+#endif
+    // power off
+    power_save();
     return 1;
 }
 
+/* Scans a row per call. Rows are read into spare buffer and matrix is
+ * switched to it when last row is done, matrix_get_row() never sees partial
+ * scan. Returns true then. */
+bool matrix_scan_step(void)
+{
+    static uint8_t row = 0;
+
+    if (!KEY_POWER_STATE()) KEY_POWER_ON();
+    matrix_prev[row] = read_row(row, matrix[row]);
+    if (++row < MATRIX_ROWS) return false;
+    row = 0;
+
+    matrix_row_t *tmp = matrix_prev;
+    matrix_prev = matrix;
+    matrix = tmp;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (matrix[i] ^ matrix_prev[i]) matrix_last_modified = timer_read32();
+    }
+#ifdef HHKB_SCAN_CALIBRATE
+    calibrate_task();
+#endif
+
+    power_save();
+    return true;
+}
+
 bool matrix_is_modified(void)
 {
     for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
@@ -194,3 +304,129 @@ void matrix_power_up(void) {
 void matrix_power_down(void) {
     KEY_POWER_OFF();
 }
+
+
+#ifdef HHKB_SCAN_CALIBRATE
+static void delay_us(uint8_t us)
+{
+    while (us--) _delay_us(1);
+}
+
+/* Samples KEY_STATE n times and returns index of last change */
+static uint8_t key_sample(uint8_t n)
+{
+    uint8_t last = 0;
+    bool state = KEY_STATE();
+    for (uint8_t i = 1; i < n; i++) {
+        bool s = KEY_STATE();
+        if (s != state) {
+            state = s;
+            last = i;
+        }
+    }
+    return last;
+}
+
+/* Samples in us, rounded up. 'per16' is sample time in 1/16us. */
+static uint8_t sample_us(uint8_t samples, uint8_t per16)
+{
+    return ((uint16_t)samples * per16 + 15) / 16;
+}
+
+static uint8_t window(uint8_t us, uint8_t per16)
+{
+    uint16_t n = (uint16_t)us * 16 / per16;
+    return (n > 255) ? 255 : n;
+}
+
+/* Measures a key and returns true if it reads pressed, only then both
+ * transitions(idle to pressed and back) are there to be timed */
+static bool measure_key(uint8_t row, uint8_t col)
+{
+    KEY_SELECT(row, col);
+    _delay_us(15);
+
+    uint8_t sreg = SREG;
+    cli();
+    KEY_ENABLE();
+    uint8_t s = key_sample(settle_n);
+    bool pressed = !KEY_STATE();
+    _delay_us(SETTLE_US);
+    KEY_UNABLE();
+    uint8_t r = key_sample(recover_n);
+    SREG = sreg;
+    _delay_us(RECOVER_US);
+
+    if (!pressed) return false;
+    if (s > cal_settle) cal_settle = s;
+    if (r > cal_recover) cal_recover = r;
+    return true;
+}
+
+static void calibrate_apply(void)
+{
+    uint8_t settle = sample_us(cal_settle, per16) + CAL_MARGIN;
+    settle_us = (settle < SETTLE_US) ? settle : SETTLE_US;
+    uint8_t recover = sample_us(cal_recover, per16) + CAL_MARGIN;
+    if (recover < RECOVER_MIN) recover = RECOVER_MIN;
+    recover_us = (recover < RECOVER_US) ? recover : RECOVER_US;
+    dprintf("calibrate: sample:%u/16us settle:%uus recover:%uus\n", per16, settle_us, recover_us);
+}
+
+/* Times a sample and measures keys pressed at startup if any */
+static void matrix_calibrate(void)
+{
+    KEY_POWER_ON();
+
+    // time of a sample, TIMER_RAW wraps at TIMER_RAW_TOP
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t t0 = TIMER_RAW;
+    key_sample(255);
+    uint8_t t1 = TIMER_RAW;
+    SREG = sreg;
+    uint16_t ticks = (t1 >= t0) ? t1 - t0 : t1 + (TIMER_RAW_TOP + 1) - t0;
+    uint16_t n = ticks * (16000000UL / TIMER_RAW_FREQ) / 255;
+    per16 = (n == 0) ? 1 : (n > 255) ? 255 : n;
+
+    // KEY_STATE is valid for 20us after KEY_ENABLE, look at first half of it
+    settle_n = window(10, per16);
+    recover_n = window(RECOVER_US, per16);
+
+    bool measured = false;
+    for (uint8_t pass = 0; pass < CAL_PASSES; pass++) {
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                if (measure_key(row, col)) measured = true;
+            }
+        }
+    }
+    if (measured) {
+        cal_keys--;
+        calibrate_apply();
+    } else {
+        dprint("calibrate: at key press\n");
+    }
+}
+
+/* Released key has no transition to time, keys are measured as they are
+ * pressed. Delays are shortened at first press and can only grow back
+ * toward fixed ones with later keys. */
+static void calibrate_task(void)
+{
+    if (!cal_keys) return;
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t pressed = matrix[row] & ~matrix_prev[row];
+        if (!pressed) continue;
+
+        uint8_t col = 0;
+        while (!(pressed & (1<<col))) col++;
+        for (uint8_t pass = 0; pass < CAL_PASSES; pass++) {
+            if (!measure_key(row, col)) return;
+        }
+        cal_keys--;
+        calibrate_apply();
+        return;
+    }
+}
+#endif
@@ -1,3 +1,4 @@
+#include <string.h>
 #include <avr/io.h>
 #include "host.h"
 #include "host_driver.h"
@@ -6,6 +7,7 @@
 #include "print.h"
 #include "timer.h"
 #include "wait.h"
+#include "debug.h"
 
 
 /* Host driver */
@@ -53,21 +55,94 @@ int16_t rn42_getc(void)
     return serial_recv2();
 }
 
-const char *rn42_gets(uint16_t timeout)
+/*
+ * Receive from module
+ *
+ * LED out report(FE 02 01 <leds>) and response lines to commands are parsed
+ * from rn42_task() as they come, instead of polling in rn42_gets().
+ */
+static char line[24];
+static uint8_t line_len = 0;
+static bool line_ready = false;
+
+/* Stops after end of line so that the line can be read */
+static void recv(bool echo)
 {
-    static char s[24];
-    uint16_t t = timer_read();
-    uint8_t i = 0;
     int16_t c;
-    while (i < 23 && timer_elapsed(t) < timeout) {
-        if ((c = rn42_getc()) != -1) {
-            if ((char)c == '\r') continue;
-            if ((char)c == '\n') break;
-            s[i++] = c;
+    while ((c = rn42_getc()) != -1) {
+        // LED Out report: 0xFE, 0x02, 0x01, <leds>
+        // To get the report over UART set bit3 with SH, command.
+        static enum {LED_INIT, LED_FE, LED_02, LED_01} state = LED_INIT;
+        switch (state) {
+            case LED_INIT:
+                if (c == 0xFE) {
+                    state = LED_FE;
+                    break;
+                }
+                if (echo) {
+                    if (0x0 <= c && c <= 0x7f) xprintf("%c", c);
+                    else xprintf(" %02X", c);
+                }
+
+                if ((char)c == '\r') break;
+                if ((char)c == '\n' || line_len == sizeof(line) - 1) {
+                    line[line_len] = '\0';
+                    line_len = 0;
+                    line_ready = true;
+                    return;
+                }
+                line_ready = false;     // not read, next line has come
+                line[line_len++] = c;
+                break;
+            case LED_FE:
+                if (c == 0x02) state = LED_02;
+                else           state = LED_INIT;
+                break;
+            case LED_02:
+                if (c == 0x01) state = LED_01;
+                else           state = LED_INIT;
+                break;
+            case LED_01:
+                dprintf("LED status: %02X\n", c);
+                rn42_set_leds(c);
+                state = LED_INIT;
+                break;
+            default:
+                state = LED_INIT;
         }
     }
-    s[i] = '\0';
-    return s;
+}
+
+void rn42_recv_task(void)
+{
+    recv(true);
+}
+
+/* Returns response line, or NULL if it is not complete yet */
+const char *rn42_getline(void)
+{
+    if (!line_ready) return NULL;
+    line_ready = false;
+    return line;
+}
+
+const char *rn42_gets(uint16_t timeout)
+{
+    const char *s;
+    uint16_t t = timer_read();
+
+    // discard line received before
+    line_ready = false;
+    line_len = 0;
+    do {
+        recv(false);
+        if ((s = rn42_getline())) return s;
+    } while (timer_elapsed(t) < timeout);
+
+    // partial line on timeout
+    line[line_len] = '\0';
+    line_len = 0;
+    return line;
 }
 
 void rn42_putc(uint8_t c)
@@ -134,6 +209,33 @@ static uint8_t leds = 0;
 static uint8_t keyboard_leds(void) { return leds; }
 void rn42_set_leds(uint8_t l) { leds = l; }
 
+/*
+ * Report frames
+ *
+ * Frames are queued in UART TX buffer and sent by interrupt. When module
+ * is not ready(RTS high) or buffer is short of space the report is kept
+ * as pending and later reports are coalesced into it, and it is sent from
+ * rn42_task().
+ */
+static uint8_t keyboard_frame[8];
+static bool keyboard_pending = false;
+static report_mouse_t mouse_frame;
+static bool mouse_pending = false;
+static uint16_t consumer_frame;
+static bool consumer_pending = false;
+
+/* Raw report mode: 0xFD, length, descriptor type, report */
+static bool send_frame(uint8_t type, const uint8_t *report, uint8_t len)
+{
+    if (rn42_rts() || serial_send_space() < len + 3) return false;
+
+    serial_send(0xFD);
+    serial_send(len + 1);
+    serial_send(type);
+    while (len--) serial_send(*report++);
+    return true;
+}
+
 static void send_keyboard(report_keyboard_t *report)
 {
     // wake from deep sleep
@@ -143,17 +245,48 @@ static void send_keyboard(report_keyboard_t *report)
     PORTD &= ~(1<<5);   // low
 */
 
-    serial_send(0xFD);  // Raw report mode
-    serial_send(9);     // length
-    serial_send(1);     // descriptor type
-    serial_send(report->mods);
-    serial_send(0x00);
-    serial_send(report->keys[0]);
-    serial_send(report->keys[1]);
-    serial_send(report->keys[2]);
-    serial_send(report->keys[3]);
-    serial_send(report->keys[4]);
-    serial_send(report->keys[5]);
+    keyboard_frame[0] = report->mods;
+    keyboard_frame[1] = 0;
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keyboard_nkro) {
+        // keyboard of RN-42 has boot report descriptor, NKRO bitmap is
+        // converted into six keys or ErrorRollOver.
+        uint8_t n = 0;
+        memset(&keyboard_frame[2], 0, 6);
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            uint8_t bits = report->nkro.bits[i];
+            for (uint8_t j = 0; bits; j++, bits >>= 1) {
+                if (!(bits & 1)) continue;
+                if (n == 6) {
+                    memset(&keyboard_frame[2], KC_ROLL_OVER, 6);
+                    goto send;
+                }
+                keyboard_frame[2 + n++] = i<<3 | j;
+            }
+        }
+    } else
+#endif
+    {
+        memcpy(&keyboard_frame[2], report->keys, 6);
+    }
+#ifdef NKRO_ENABLE
+send:
+#endif
+    keyboard_pending = !send_frame(1, keyboard_frame, sizeof(keyboard_frame));
+}
+
+static int8_t add_sat(int8_t a, int8_t b)
+{
+    int16_t r = (int16_t)a + b;
+    if (r > 127) return 127;
+    if (r < -127) return -127;
+    return r;
+}
+
+static bool send_mouse_frame(void)
+{
+    uint8_t frame[4] = { mouse_frame.buttons, mouse_frame.x, mouse_frame.y, mouse_frame.v };
+    return send_frame(2, frame, sizeof(frame));
 }
 
 static void send_mouse(report_mouse_t *report)
@@ -165,13 +298,16 @@ static void send_mouse(report_mouse_t *report)
     PORTD &= ~(1<<5);   // low
 */
 
-    serial_send(0xFD);  // Raw report mode
-    serial_send(5);     // length
-    serial_send(2);     // descriptor type
-    serial_send(report->buttons);
-    serial_send(report->x);
-    serial_send(report->y);
-    serial_send(report->v);
+    if (mouse_pending) {
+        // movement is accumulated
+        mouse_frame.buttons = report->buttons;
+        mouse_frame.x = add_sat(mouse_frame.x, report->x);
+        mouse_frame.y = add_sat(mouse_frame.y, report->y);
+        mouse_frame.v = add_sat(mouse_frame.v, report->v);
+    } else {
+        mouse_frame = *report;
+    }
+    mouse_pending = !send_mouse_frame();
 }
 
 static void send_system(uint16_t data)
@@ -204,14 +340,35 @@ static uint16_t usage2bits(uint16_t usage)
     return 0;
 }
 
+static bool send_consumer_frame(void)
+{
+    uint8_t frame[2] = { consumer_frame&0xFF, (consumer_frame>>8)&0xFF };
+    return send_frame(3, frame, sizeof(frame));
+}
+
 static void send_consumer(uint16_t data)
 {
-    uint16_t bits = usage2bits(data);
-    serial_send(0xFD);  // Raw report mode
-    serial_send(3);     // length
-    serial_send(3);     // descriptor type
-    serial_send(bits&0xFF);
-    serial_send((bits>>8)&0xFF);
+    consumer_frame = usage2bits(data);
+    consumer_pending = !send_consumer_frame();
+}
+
+/* Sends pending reports; called from rn42_task() */
+void rn42_send_pending(void)
+{
+    if (host_get_driver() != &rn42_driver) {
+        // keyboard is cleared on driver change
+        keyboard_pending = mouse_pending = consumer_pending = false;
+        return;
+    }
+    if (keyboard_pending) {
+        keyboard_pending = !send_frame(1, keyboard_frame, sizeof(keyboard_frame));
+    }
+    if (mouse_pending && !keyboard_pending) {
+        mouse_pending = !send_mouse_frame();
+    }
+    if (consumer_pending && !keyboard_pending && !mouse_pending) {
+        consumer_pending = !send_consumer_frame();
+    }
 }
 
 
@@ -8,6 +8,8 @@ host_driver_t rn42_config_driver;
 
 void rn42_init(void);
 int16_t rn42_getc(void);
+void rn42_recv_task(void);
+const char *rn42_getline(void);
 const char *rn42_gets(uint16_t timeout);
 void rn42_putc(uint8_t c);
 void rn42_puts(char *s);
@@ -19,5 +21,6 @@ void rn42_cts_hi(void);
 void rn42_cts_lo(void);
 bool rn42_linked(void);
 void rn42_set_leds(uint8_t l);
+void rn42_send_pending(void);
 
 #endif
@@ -19,6 +19,14 @@
 static bool config_mode = false;
 static bool force_usb = false;
 
+/* RTS is high while module is not powered and also for short while it is
+ * busy(flow control). USB is chosen only after RTS stays high this long,
+ * so reports held in busy period are sent on Bluetooth. */
+#ifndef RN42_RTS_TIMEOUT
+#define RN42_RTS_TIMEOUT    200     // ms
+#endif
+static uint16_t rts_low_time = 0;
+
 static void status_led(bool on)
 {
     if (on) {
@@ -37,44 +45,17 @@ void rn42_task_init(void)
 
 void rn42_task(void)
 {
-    int16_t c;
-    // Raw mode: interpret output report of LED state
-    while ((c = rn42_getc()) != -1) {
-        // LED Out report: 0xFE, 0x02, 0x01, <leds>
-        // To get the report over UART set bit3 with SH, command.
-        static enum {LED_INIT, LED_FE, LED_02, LED_01} state = LED_INIT;
-        switch (state) {
-            case LED_INIT:
-                if (c == 0xFE) state = LED_FE;
-                else {
-                    if (0x0 <= c && c <= 0x7f) xprintf("%c", c);
-                    else xprintf(" %02X", c);
-                }
-                break;
-            case LED_FE:
-                if (c == 0x02) state = LED_02;
-                else           state = LED_INIT;
-                break;
-            case LED_02:
-                if (c == 0x01) state = LED_01;
-                else           state = LED_INIT;
-                break;
-            case LED_01:
-                dprintf("LED status: %02X\n", c);
-                rn42_set_leds(c);
-                state = LED_INIT;
-                break;
-            default:
-                state = LED_INIT;
-        }
-    }
+    // LED out report and command response
+    rn42_recv_task();
 
     /* Bluetooth mode when ready */
+    if (!rn42_rts()) rts_low_time = timer_read();
     if (!config_mode && !force_usb) {
         if (!rn42_rts() && host_get_driver() != &rn42_driver) {
             clear_keyboard();
             host_set_driver(&rn42_driver);
-        } else if (rn42_rts() && host_get_driver() != &lufa_driver) {
+        } else if (rn42_rts() && timer_elapsed(rts_low_time) > RN42_RTS_TIMEOUT &&
+                   host_get_driver() != &lufa_driver) {
             clear_keyboard();
             host_set_driver(&lufa_driver);
         }
@@ -110,6 +91,10 @@ void rn42_task(void)
     }
 
 
+    /* Reports held while module is busy */
+    rn42_send_pending();
+
+
     /* Connection monitor */
     if (!rn42_rts() && rn42_linked()) {
         status_led(true);
@@ -56,6 +56,21 @@ ifdef NKRO_ENABLE
     OPT_DEFS += -DNKRO_ENABLE
 endif
 
+ifdef LATENCY_ENABLE
+    SRC += $(COMMON_DIR)/latency.c
+    OPT_DEFS += -DLATENCY_ENABLE
+endif
+
+ifdef LOOP_STATS_ENABLE
+    SRC += $(COMMON_DIR)/loop_stats.c
+    OPT_DEFS += -DLOOP_STATS_ENABLE
+endif
+
+ifdef TRACE_ENABLE
+    SRC += $(COMMON_DIR)/trace.c
+    OPT_DEFS += -DTRACE_ENABLE
+endif
+
 ifdef USB_6KRO_ENABLE
     OPT_DEFS += -DUSB_6KRO_ENABLE
 endif
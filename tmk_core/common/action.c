@@ -27,19 +27,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_util.h"
 #include "action.h"
 #include "hook.h"
+#include "latency.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
 #else
 #include "nodebug.h"
 #endif
+#include "trace.h"
 
 
 void action_exec(keyevent_t event)
 {
     if (!IS_NOEVENT(event)) {
+#ifndef TRACE_ENABLE
         dprint("\n---- action_exec: start -----\n");
         dprint("EVENT: "); debug_event(event); dprintln();
+#endif
+        trace(TRACE_KEY, event.key.row<<8 | event.key.col, event.pressed);
         hook_matrix_change(event);
     }
 
@@ -63,14 +68,18 @@ void process_action(keyrecord_t *record)
 #endif
 
     if (IS_NOEVENT(event)) { return; }
+    latency_dispatch(event);
 
     action_t action = layer_switch_get_action(event.key);
+    trace(TRACE_ACTION, action.code, event.pressed);
+#ifndef TRACE_ENABLE
     dprint("ACTION: "); debug_action(action);
 #ifndef NO_ACTION_LAYER
     dprint(" layer_state: "); layer_debug();
     dprint(" default_layer_state: "); default_layer_debug();
 #endif
     dprintln();
+#endif
 
     switch (action.kind.id) {
         /* Key and Mods */
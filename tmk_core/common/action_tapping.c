@@ -11,6 +11,7 @@
 #else
 #include "nodebug.h"
 #endif
+#include "trace.h"
 
 #ifndef NO_ACTION_TAPPING
 
@@ -39,12 +40,15 @@ void action_tapping_process(keyrecord_t record)
 {
     if (process_tapping(&record)) {
         if (!IS_NOEVENT(record.event)) {
+#ifndef TRACE_ENABLE
             debug("processed: "); debug_record(record); debug("\n");
+#endif
+            trace(TRACE_TAPPING, record.event.key.row<<8 | record.event.key.col, record.tap.count);
         }
     } else {
         if (!waiting_buffer_enq(record)) {
             // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
+            trace_dprintf(TRACE_TAPPING_OVERFLOW, 0, 0, "OVERFLOW: CLEAR ALL STATES\n");
             clear_keyboard();
             waiting_buffer_clear();
             tapping_key = (keyrecord_t){};
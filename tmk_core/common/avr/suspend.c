@@ -40,6 +40,59 @@ void suspend_idle(uint8_t time)
     sleep_disable();
 }
 
+/*
+ * Pin change wakeup
+ *
+ * Board declares column pins on pin change interrupt with
+ * SUSPEND_WAKEUP_PCMSKn in config.h and drives all rows active in
+ * matrix_wakeup_select(), so that any key press wakes MCU at once. Watchdog
+ * wakes it only every SUSPEND_WAKEUP_WDTO as fallback, e.g. for a key held
+ * down when going to sleep.
+ */
+#if defined(SUSPEND_WAKEUP_PCMSK0) || defined(SUSPEND_WAKEUP_PCMSK1) || defined(SUSPEND_WAKEUP_PCMSK2)
+#   define SUSPEND_WAKEUP_PCINT
+#   ifndef SUSPEND_WAKEUP_WDTO
+#       define SUSPEND_WAKEUP_WDTO  WDTO_250MS
+#   endif
+#endif
+
+#ifdef SUSPEND_WAKEUP_PCINT
+static void pcint_arm(void)
+{
+#ifdef SUSPEND_WAKEUP_PCMSK0
+    PCMSK0 |= SUSPEND_WAKEUP_PCMSK0;
+    PCIFR = (1<<PCIF0);
+    PCICR |= (1<<PCIE0);
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK1
+    PCMSK1 |= SUSPEND_WAKEUP_PCMSK1;
+    PCIFR = (1<<PCIF1);
+    PCICR |= (1<<PCIE1);
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK2
+    PCMSK2 |= SUSPEND_WAKEUP_PCMSK2;
+    PCIFR = (1<<PCIF2);
+    PCICR |= (1<<PCIE2);
+#endif
+}
+
+static void pcint_disarm(void)
+{
+#ifdef SUSPEND_WAKEUP_PCMSK0
+    PCICR &= ~(1<<PCIE0);
+    PCMSK0 &= (uint8_t)~SUSPEND_WAKEUP_PCMSK0;
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK1
+    PCICR &= ~(1<<PCIE1);
+    PCMSK1 &= (uint8_t)~SUSPEND_WAKEUP_PCMSK1;
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK2
+    PCICR &= ~(1<<PCIE2);
+    PCMSK2 &= (uint8_t)~SUSPEND_WAKEUP_PCMSK2;
+#endif
+}
+#endif
+
 /* Power down MCU with watchdog timer
  * wdto: watchdog timer timeout defined in <avr/wdt.h>
  *          WDTO_15MS
@@ -68,10 +121,13 @@ static void power_down(uint8_t wdto)
     // See PicoPower application note
     // - I/O port input with pullup
     // - prescale clock
-    // - BOD disable
     // - Power Reduction Register PRR
     set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    cli();
     sleep_enable();
+#if defined(BODS) && defined(BODSE)
+    sleep_bod_disable();
+#endif
     sei();
     sleep_cpu();
     sleep_disable();
@@ -82,11 +138,21 @@ static void power_down(uint8_t wdto)
 
 void suspend_power_down(void)
 {
+#ifdef SUSPEND_WAKEUP_PCINT
+    matrix_wakeup_select();
+    pcint_arm();
+    power_down(SUSPEND_WAKEUP_WDTO);
+    pcint_disarm();
+    matrix_wakeup_unselect();
+#else
     power_down(WDTO_15MS);
+#endif
 }
 
 __attribute__ ((weak)) void matrix_power_up(void) {}
 __attribute__ ((weak)) void matrix_power_down(void) {}
+__attribute__ ((weak)) void matrix_wakeup_select(void) {}
+__attribute__ ((weak)) void matrix_wakeup_unselect(void) {}
 bool suspend_wakeup_condition(void)
 {
     matrix_power_up();
@@ -113,12 +179,44 @@ void suspend_wakeup_init(void)
 ISR(WDT_vect)
 {
     // compensate timer for sleep
+    // NOTE: time is lost when pin change wakes MCU before timeout
     switch (wdt_timeout) {
         case WDTO_15MS:
             timer_count += 15 + 2;  // WDTO_15MS + 2(from observation)
             break;
+        case WDTO_120MS:
+            timer_count += 120;
+            break;
+        case WDTO_250MS:
+            timer_count += 250;
+            break;
+        case WDTO_500MS:
+            timer_count += 500;
+            break;
         default:
             ;
     }
 }
 #endif
+
+#ifdef SUSPEND_WAKEUP_PCINT
+/* key press: only to wake up, matrix is scanned in suspend_wakeup_condition() */
+#ifdef SUSPEND_WAKEUP_PCMSK0
+ISR(PCINT0_vect)
+{
+    PCICR &= ~(1<<PCIE0);
+}
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK1
+ISR(PCINT1_vect)
+{
+    PCICR &= ~(1<<PCIE1);
+}
+#endif
+#ifdef SUSPEND_WAKEUP_PCMSK2
+ISR(PCINT2_vect)
+{
+    PCICR &= ~(1<<PCIE2);
+}
+#endif
+#endif
@@ -110,6 +110,22 @@ uint32_t timer_elapsed32(uint32_t last)
     return TIMER_DIFF_32(t, last);
 }
 
+uint32_t timer_read_us(void)
+{
+    uint32_t t;
+    uint8_t raw;
+
+    uint8_t sreg = SREG;
+    cli();
+    t = timer_count;
+    raw = TIMER_RAW;
+    // counter has been cleared but its interrupt is not served yet
+    if ((TIFR0 & (1<<OCF0A)) && raw < TIMER_RAW_TOP/2) t++;
+    SREG = sreg;
+
+    return t * 1000 + TIMER_RAW_TO_US(raw);
+}
+
 // excecuted once per 1ms.(excess for just timer count?)
 ISR(TIMER0_COMPA_vect)
 {
@@ -25,3 +25,9 @@ uint32_t timer_elapsed32(uint32_t last)
 {
     return ST2MS(chVTTimeElapsedSinceX(MS2ST(last)));
 }
+
+/* resolution is of system tick(CH_CFG_ST_FREQUENCY) */
+uint32_t timer_read_us(void)
+{
+    return (uint32_t)chVTGetSystemTimeX() * (1000000 / CH_CFG_ST_FREQUENCY);
+}
@@ -33,6 +33,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "led.h"
 #include "command.h"
 #include "backlight.h"
+#include "latency.h"
+#include "loop_stats.h"
 
 #ifdef MOUSEKEY_ENABLE
 #include "mousekey.h"
@@ -50,6 +52,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 
+/* Buffer stats of protocol drivers, null unless the driver is linked in */
+void ps2_host_print_stats(void) __attribute__ ((weak));
+void xt_host_print_stats(void) __attribute__ ((weak));
+void ibm4704_print_stats(void) __attribute__ ((weak));
+void serial_print_stats(void) __attribute__ ((weak));
+void news_print_stats(void) __attribute__ ((weak));
+
 static bool command_common(uint8_t code);
 static void command_common_help(void);
 static bool command_console(uint8_t code);
@@ -121,6 +130,7 @@ static void command_common_help(void)
           "m:	debug mouse\n"
           "v:	version\n"
           "s:	status\n"
+          "b:	buffer stats\n"
           "c:	console mode\n"
           "0-4:	layer0-4(F10-F4)\n"
           "Paus:	bootloader\n"
@@ -140,6 +150,14 @@ static void command_common_help(void)
 #ifdef SLEEP_LED_ENABLE
           "z:	sleep LED test\n"
 #endif
+
+#ifdef LATENCY_ENABLE
+          "l:	latency stats(and clear)\n"
+#endif
+
+#ifdef LOOP_STATS_ENABLE
+          "t:	loop time and stack\n"
+#endif
     );
 }
 
@@ -192,6 +210,17 @@ static bool command_common(uint8_t code)
             led_set(host_keyboard_leds());
             break;
 #endif
+#ifdef LOOP_STATS_ENABLE
+        case KC_T:
+            loop_stats_print();
+            break;
+#endif
+#ifdef LATENCY_ENABLE
+        case KC_L:
+            latency_print();
+            latency_clear();
+            break;
+#endif
 #ifdef BOOTMAGIC_ENABLE
         case KC_E:
             print("eeconfig:\n");
@@ -211,6 +240,15 @@ static bool command_common(uint8_t code)
             }
             break;
 #endif
+        case KC_B:
+            print("\n\t- Buffer -\n");
+            keyboard_print_stats();
+            if (ps2_host_print_stats) ps2_host_print_stats();
+            if (xt_host_print_stats) xt_host_print_stats();
+            if (ibm4704_print_stats) ibm4704_print_stats();
+            if (serial_print_stats) serial_print_stats();
+            if (news_print_stats) news_print_stats();
+            break;
         case KC_H:
         case KC_SLASH: /* ? */
             command_common_help();
@@ -310,6 +348,12 @@ static bool command_common(uint8_t code)
 #endif
 #ifdef KEYMAP_SECTION_ENABLE
             " KEYMAP_SECTION"
+#endif
+#ifdef LATENCY_ENABLE
+            " LATENCY"
+#endif
+#ifdef LOOP_STATS_ENABLE
+            " LOOP_STATS"
 #endif
             " " STR(BOOTLOADER_SIZE) "\n");
 
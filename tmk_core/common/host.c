@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#include "latency.h"
+#include "trace.h"
 
 
 #ifdef NKRO_ENABLE
@@ -51,8 +53,18 @@ uint8_t host_keyboard_leds(void)
 void host_keyboard_send(report_keyboard_t *report)
 {
     if (!driver) return;
+    latency_enqueue();
     (*driver->send_keyboard)(report);
 
+#ifdef TRACE_ENABLE
+    // whole report in records of four bytes, NKRO bitmap takes several
+    if (debug_keyboard) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_SIZE; i += 4) {
+            trace(i ? TRACE_KEYBOARD_CONT : TRACE_KEYBOARD,
+                  report->raw[i]<<8 | report->raw[i + 1], report->raw[i + 2]<<8 | report->raw[i + 3]);
+        }
+    }
+#else
     if (debug_keyboard) {
         dprint("keyboard_report: ");
         for (uint8_t i = 0; i < KEYBOARD_REPORT_SIZE; i++) {
@@ -60,6 +72,7 @@ void host_keyboard_send(report_keyboard_t *report)
         }
         dprint("\n");
     }
+#endif
 }
 
 void host_mouse_send(report_mouse_t *report)
@@ -31,6 +31,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "hook.h"
+#include "ring_buffer.h"
+#include "latency.h"
+#include "loop_stats.h"
+#include "trace.h"
 #ifdef MOUSEKEY_ENABLE
 #   include "mousekey.h"
 #endif
@@ -63,7 +67,36 @@ static bool has_ghost_in_row(uint8_t row)
 #endif
 
 
+/*
+ * Key events before host is ready
+ *
+ * Protocol runs keyboard_init() and keyboard_task() while USB enumeration
+ * is in progress and sets host driver once host has configured device.
+ * Until then key events are held in queue and they are replayed in order
+ * after that, one per task call, so that keys pressed while booting are
+ * not lost. When queue is full the change stays in matrix and is picked up
+ * later.
+ */
+#ifndef KEY_QUEUE_SIZE
+#define KEY_QUEUE_SIZE  8       // power of 2, holds 7 events
+#endif
+RING_BUFFER(key_queue, keyevent_t, KEY_QUEUE_SIZE)
+static bool first_key = true;
+
+static void key_exec(keyevent_t e)
+{
+    if (first_key) {
+        first_key = false;
+        xprintf("first key: %lums\n", timer_read32());
+    }
+    latency_detect(e);
+    action_exec(e);
+    hook_matrix_change(e);
+}
+
+
 __attribute__ ((weak)) void matrix_setup(void) {}
+__attribute__ ((weak)) bool matrix_scan_step(void) { matrix_scan(); return true; }
 void keyboard_setup(void)
 {
     matrix_setup();
@@ -107,7 +140,21 @@ void keyboard_task(void)
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
 
+    loop_stats_task();
+
+#ifdef MATRIX_SCAN_STEP
+    // short slice per call; events come from last complete scan
+    if (matrix_scan_step()) loop_stats_scan();
+#else
     matrix_scan();
+    loop_stats_scan();
+#endif
+
+    if (host_get_driver() && key_queue_has_data()) {
+        key_exec(key_queue_dequeue());
+        goto MATRIX_LOOP_END;
+    }
+
     for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
         matrix_row = matrix_get_row(r);
         matrix_change = matrix_row ^ matrix_prev[r];
@@ -134,8 +181,11 @@ void keyboard_task(void)
                         .pressed = (matrix_row & ((matrix_row_t)1<<c)),
                         .time = (timer_read() | 1) /* time should not be 0 */
                     };
-                    action_exec(e);
-                    hook_matrix_change(e);
+                    if (host_get_driver()) {
+                        key_exec(e);
+                    } else if (!key_queue_enqueue(e)) {
+                        goto MATRIX_LOOP_END;
+                    }
                     // record a processed key
                     matrix_prev[r] ^= ((matrix_row_t)1<<c);
                     // process a key per task call
@@ -150,6 +200,7 @@ void keyboard_task(void)
 MATRIX_LOOP_END:
 
     hook_keyboard_loop();
+    trace_task();
 
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
@@ -176,6 +227,12 @@ MATRIX_LOOP_END:
     }
 }
 
+void keyboard_print_stats(void)
+{
+    ring_buffer_stats_t b = key_queue_stats();
+    xprintf("key queue: dropped:%u high:%u/%u\n", b.dropped, b.high, b.size);
+}
+
 void keyboard_set_leds(uint8_t leds)
 {
     led_set(leds);
@@ -66,6 +66,8 @@ void keyboard_init(void);
 void keyboard_task(void);
 /* it runs when host LED status is updated */
 void keyboard_set_leds(uint8_t leds);
+/* prints drop count and high-water mark of key event queue */
+void keyboard_print_stats(void);
 
 #ifdef __cplusplus
 }
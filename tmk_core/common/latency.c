@@ -0,0 +1,179 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+#include "timer.h"
+#include "print.h"
+#include "latency.h"
+
+
+/* Histogram bucket n counts time of n significant bits, that is
+ * 2^(n-1) to 2^n-1 us. Last bucket takes 16ms and longer. */
+#define LATENCY_BUCKETS     16
+
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint16_t count;
+    uint16_t hist[LATENCY_BUCKETS];
+} latency_stat_t;
+
+enum {
+    IDLE = 0,
+    DETECTED,
+    DISPATCHED,
+    ENQUEUED,
+    SENT,
+};
+
+static latency_stat_t stats[LATENCY_STAGES];
+static uint16_t dropped;
+
+/* event being followed */
+static keyevent_t sample;
+static uint32_t detect_at;
+static uint32_t dispatch_at;
+static uint32_t enqueue_at;
+static volatile uint32_t sent_at;
+// sent may be marked in USB interrupt
+static volatile uint8_t state = IDLE;
+
+
+static uint8_t bucket(uint32_t us)
+{
+    uint8_t n = 0;
+    while (us && n < LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static void add(uint8_t stage, uint32_t us)
+{
+    latency_stat_t *s = &stats[stage];
+    if (s->count == UINT16_MAX || s->sum + us < s->sum) return;
+
+    if (s->count == 0 || us < s->min) s->min = us;
+    if (us > s->max) s->max = us;
+    s->sum += us;
+    s->count++;
+    s->hist[bucket(us)]++;
+}
+
+void latency_task(void)
+{
+    if (state != SENT) return;
+
+    add(LATENCY_DISPATCH, dispatch_at - detect_at);
+    add(LATENCY_ENQUEUE,  enqueue_at - dispatch_at);
+    add(LATENCY_SENT,     sent_at - enqueue_at);
+    add(LATENCY_TOTAL,    sent_at - detect_at);
+    state = IDLE;
+}
+
+void latency_detect(keyevent_t event)
+{
+    latency_task();
+    if (state != IDLE && dropped != UINT16_MAX) dropped++;
+
+    sample = event;
+    detect_at = timer_read_us();
+    state = DETECTED;
+}
+
+void latency_dispatch(keyevent_t event)
+{
+    if (state != DETECTED) return;
+    if (!KEYEQ(event.key, sample.key) || event.pressed != sample.pressed) return;
+
+    dispatch_at = timer_read_us();
+    state = DISPATCHED;
+}
+
+void latency_enqueue(void)
+{
+    if (state != DISPATCHED) return;
+
+    enqueue_at = timer_read_us();
+    state = ENQUEUED;
+}
+
+void latency_sent(void)
+{
+    if (state != ENQUEUED) return;
+
+    sent_at = timer_read_us();
+    state = SENT;
+}
+
+/* driver polls endpoint for latency_sent() while this is true */
+bool latency_waiting(void)
+{
+    return (state == ENQUEUED);
+}
+
+void latency_clear(void)
+{
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        latency_stat_t *s = &stats[i];
+        s->min = s->max = s->sum = 0;
+        s->count = 0;
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            s->hist[b] = 0;
+        }
+    }
+    dropped = 0;
+}
+
+/* upper bound of bucket where 99% of samples are in */
+static uint32_t p99(latency_stat_t *s)
+{
+    uint16_t rank = s->count - s->count / 100;
+    uint16_t n = 0;
+    for (uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+        n += s->hist[b];
+        if (n >= rank) {
+            uint32_t bound = ((uint32_t)1<<b) - 1;
+            return (bound < s->max) ? bound : s->max;
+        }
+    }
+    return s->max;
+}
+
+void latency_print(void)
+{
+    static const char *const names[LATENCY_STAGES] = {
+        "dispatch", "enqueue ", "sent    ", "total   "
+    };
+
+    latency_task();
+    print("\n\t- Latency(us) -\n"
+          "stage   \tmin\tavg\tmax\tp99\tn\n");
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        latency_stat_t *s = &stats[i];
+        if (s->count == 0) {
+            xprintf("%s\t-\n", names[i]);
+            continue;
+        }
+        xprintf("%s\t%lu\t%lu\t%lu\t<=%lu\t%u\n", names[i],
+                s->min, s->sum / s->count, s->max, p99(s), s->count);
+    }
+    xprintf("dropped: %u\n", dropped);
+}
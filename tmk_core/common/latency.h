@@ -0,0 +1,71 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+
+
+/*
+ * Input latency measurement
+ *
+ * A key event is followed through these points and time between them is
+ * taken with timer_read_us().
+ *
+ *   detect     keyboard_task() finds change in matrix(after debounce)
+ *   dispatch   process_action() gets the event(after tapping)
+ *   enqueue    host_keyboard_send() passes report to driver
+ *   sent       driver sees the report has been read by host
+ *
+ * One event is followed at a time. Event which makes no keyboard report
+ * (layer, mouse key) or is overtaken by next event before its report is
+ * sent is counted as dropped. Magic+l prints and clears the stats.
+ *
+ * Enable with LATENCY_ENABLE = yes in Makefile, otherwise calls are
+ * compiled out.
+ */
+enum latency_stage {
+    LATENCY_DISPATCH = 0,   // detect   -> dispatch
+    LATENCY_ENQUEUE,        // dispatch -> enqueue
+    LATENCY_SENT,           // enqueue  -> sent
+    LATENCY_TOTAL,          // detect   -> sent
+    LATENCY_STAGES
+};
+
+#ifdef LATENCY_ENABLE
+void latency_detect(keyevent_t event);
+void latency_dispatch(keyevent_t event);
+void latency_enqueue(void);
+void latency_sent(void);
+bool latency_waiting(void);
+void latency_task(void);
+void latency_print(void);
+void latency_clear(void);
+#else
+#define latency_detect(event)
+#define latency_dispatch(event)
+#define latency_enqueue()
+#define latency_sent()
+#define latency_waiting()       false
+#define latency_task()
+#define latency_print()
+#define latency_clear()
+#endif
+
+#endif
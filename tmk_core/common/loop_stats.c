@@ -0,0 +1,114 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include "timer.h"
+#include "print.h"
+#include "loop_stats.h"
+
+
+loop_stats_t loop_stats;
+
+static uint16_t scans;
+static uint16_t loops;
+static uint16_t loop_max;
+static uint32_t loop_sum;
+static uint32_t loop_last;
+static uint16_t second;
+
+
+void loop_stats_scan(void)
+{
+    if (scans != UINT16_MAX) scans++;
+}
+
+/* Called at start of keyboard_task() */
+void loop_stats_task(void)
+{
+    uint32_t now = timer_read_us();
+    if (loop_last) {
+        uint32_t t = now - loop_last;
+        if (t > UINT16_MAX) t = UINT16_MAX;
+        if (t > loop_max) loop_max = t;
+        loop_sum += t;
+        loops++;
+    }
+    loop_last = now | 1;
+
+    if (timer_elapsed(second) < 1000) return;
+    second = timer_read();
+
+    loop_stats.scans = scans;
+    loop_stats.loops = loops;
+    loop_stats.loop_avg = loops ? loop_sum / loops : 0;
+    loop_stats.loop_max = loop_max;
+    scans = loops = loop_max = 0;
+    loop_sum = 0;
+}
+
+void loop_stats_print(void)
+{
+    print("\n\t- Loop -\n");
+    xprintf("scan/s: %u\n", loop_stats.scans);
+    xprintf("loop/s: %u\n", loop_stats.loops);
+    xprintf("loop avg: %uus\n", loop_stats.loop_avg);
+    xprintf("loop max: %uus\n", loop_stats.loop_max);
+#ifdef __AVR__
+    xprintf("stack unused: %u\n", stack_unused());
+#endif
+}
+
+
+#ifdef __AVR__
+#ifndef STACK_CANARY
+#define STACK_CANARY    0xC5
+#endif
+
+extern uint8_t _end;
+extern uint8_t __stack;
+
+/* Paints free RAM before stack pointer and .data/.bss are set up, so this
+ * must not use stack nor r1 */
+void stack_paint(void) __attribute__ ((naked, used, section (".init1")));
+void stack_paint(void)
+{
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(_end)         \n"
+        "    ldi r31, hi8(_end)         \n"
+        "    ldi r24, %0                \n"
+        "    ldi r25, hi8(__stack)      \n"
+        "    rjmp 2f                    \n"
+        "1:  st Z+, r24                 \n"
+        "2:  cpi r30, lo8(__stack)      \n"
+        "    cpc r31, r25               \n"
+        "    brlo 1b                    \n"
+        "    breq 1b                    \n"
+        :: "i" (STACK_CANARY)
+    );
+}
+
+/* Bytes above .bss never written, stack has not grown into them yet */
+uint16_t stack_unused(void)
+{
+    const uint8_t *p = &_end;
+    uint16_t n = 0;
+    while (p <= &__stack && *p == STACK_CANARY) {
+        p++;
+        n++;
+    }
+    return n;
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <stdint.h>
+
+
+/*
+ * Main loop and scan rate counters
+ *
+ * Time of a main loop is measured from one keyboard_task() call to next,
+ * so it includes protocol work like USB task. Counts of last second are
+ * in loop_stats, which can be read from hook_keyboard_loop(). Magic+t
+ * prints them with unused stack.
+ *
+ * On AVR RAM between end of .bss and top of stack is painted with
+ * STACK_CANARY before main() and stack_unused() counts bytes still intact
+ * from bottom, that is the margin left at deepest stack use so far.
+ *
+ * Enable with LOOP_STATS_ENABLE = yes in Makefile, otherwise calls are
+ * compiled out.
+ */
+typedef struct {
+    uint16_t scans;     // complete matrix scans per second
+    uint16_t loops;     // main loops per second
+    uint16_t loop_avg;  // us
+    uint16_t loop_max;  // us, longest loop in the second
+} loop_stats_t;
+
+#ifdef LOOP_STATS_ENABLE
+extern loop_stats_t loop_stats;
+
+void loop_stats_task(void);
+void loop_stats_scan(void);
+void loop_stats_print(void);
+#ifdef __AVR__
+uint16_t stack_unused(void);
+#endif
+#else
+#define loop_stats_task()
+#define loop_stats_scan()
+#define loop_stats_print()
+#endif
+
+#endif
@@ -49,6 +49,9 @@ void matrix_setup(void);
 void matrix_init(void);
 /* scan all key states on matrix */
 uint8_t matrix_scan(void);
+/* scan a slice of matrix, returns true when whole matrix is updated.(optional)
+ * matrix_get_row() returns last complete scan until then. */
+bool matrix_scan_step(void);
 /* whether modified from previous scan. used after matrix_scan. */
 bool matrix_is_modified(void) __attribute__ ((deprecated));
 /* whether a swtich is on */
@@ -62,6 +65,9 @@ void matrix_print(void);
 /* power control */
 void matrix_power_up(void);
 void matrix_power_down(void);
+/* suspend: select all rows so that key press changes column pins(optional) */
+void matrix_wakeup_select(void);
+void matrix_wakeup_unselect(void);
 
 #ifdef __cplusplus
 }
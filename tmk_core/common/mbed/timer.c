@@ -39,3 +39,14 @@ uint32_t timer_elapsed32(uint32_t last)
 {
     return TIMER_DIFF_32(timer_read32(), last);
 }
+
+/* SysTick counts down from LOAD to 0 in a millisecond */
+uint32_t timer_read_us(void)
+{
+    uint32_t ms, val;
+    do {
+        ms = timer_count;
+        val = SysTick->VAL;
+    } while (ms != timer_count);
+    return ms * 1000 + (SysTick->LOAD - val) * 1000 / (SysTick->LOAD + 1);
+}
@@ -89,6 +89,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   define KEYBOARD_REPORT_SIZE NKRO_EPSIZE
 #   define KEYBOARD_REPORT_KEYS (NKRO_EPSIZE - 2)
 #   define KEYBOARD_REPORT_BITS (NKRO_EPSIZE - 1)
+#elif defined(PROTOCOL_VUSB) && defined(NKRO_ENABLE)
+    /* NKRO bitmap is sent in 8-byte chunks, boot report keeps 6 keys */
+#   define KEYBOARD_REPORT_SIZE 16
+#   define KEYBOARD_REPORT_KEYS 6
+#   define KEYBOARD_REPORT_BITS 15
 
 #else
 #   define KEYBOARD_REPORT_SIZE 8
@@ -0,0 +1,78 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+/*--------------------------------------------------------------------
+ * Single-producer single-consumer ring buffer
+ *
+ * RING_BUFFER(name, type, size) defines a buffer and its functions
+ * name_enqueue(), name_dequeue(), name_has_data(), name_count() and
+ * name_clear() in the includer. One side(typically ISR) only enqueues and
+ * the other(main loop) only dequeues, head is written by producer and tail
+ * by consumer. Both are single bytes, so neither side needs to disable
+ * interrupts.
+ *
+ * size must be power of two up to 256, one cell is kept unused to tell
+ * full from empty.
+ *
+ * name_stats() returns counters of the buffer, see ring_buffer_stats_t.
+ *------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint8_t dropped;    // number of data lost on full buffer(saturates at 255)
+    uint8_t high;       // high-water mark of data count
+    uint8_t size;       // capacity(size - 1)
+} ring_buffer_stats_t;
+
+// keeps compiler from moving buffer access across index update
+#define RING_BUFFER_BARRIER()   __asm__ __volatile__ ("" ::: "memory")
+
+#define RING_BUFFER(name, type, size) \
+typedef char name##_size_must_be_power_of_two[((size) & ((size) - 1)) == 0 && (size) <= 256 ? 1 : -1]; \
+static type name[size]; \
+static volatile uint8_t name##_head = 0; \
+static volatile uint8_t name##_tail = 0; \
+static uint8_t name##_dropped = 0; \
+static uint8_t name##_high = 0; \
+static inline uint8_t name##_count(void) \
+{ \
+    return (uint8_t)(name##_head - name##_tail) & (uint8_t)((size) - 1); \
+} \
+static inline bool name##_enqueue(type data) \
+{ \
+    uint8_t head = name##_head; \
+    uint8_t next = (head + 1) & (uint8_t)((size) - 1); \
+    if (next == name##_tail) { \
+        if (name##_dropped != 0xFF) name##_dropped++; \
+        return false; \
+    } \
+    name[head] = data; \
+    RING_BUFFER_BARRIER(); \
+    name##_head = next; \
+    uint8_t count = name##_count(); \
+    if (count > name##_high) name##_high = count; \
+    return true; \
+} \
+static inline type name##_dequeue(void) \
+{ \
+    uint8_t tail = name##_tail; \
+    if (tail == name##_head) return (type){ 0 }; \
+    type data = name[tail]; \
+    RING_BUFFER_BARRIER(); \
+    name##_tail = (tail + 1) & (uint8_t)((size) - 1); \
+    return data; \
+} \
+static inline bool name##_has_data(void) \
+{ \
+    return (name##_head != name##_tail); \
+} \
+static inline void name##_clear(void) \
+{ \
+    name##_tail = name##_head; \
+} \
+static inline ring_buffer_stats_t name##_stats(void) \
+{ \
+    return (ring_buffer_stats_t){ name##_dropped, name##_high, (uint8_t)((size) - 1) }; \
+}
+
+#endif  /* RING_BUFFER_H */
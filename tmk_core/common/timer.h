@@ -45,6 +45,9 @@ uint16_t timer_read(void);
 uint32_t timer_read32(void);
 uint16_t timer_elapsed(uint16_t last);
 uint32_t timer_elapsed32(uint32_t last);
+/* time in microseconds for latency measurement, resolution depends on port
+ * (4us on AVR at 16MHz), wraps around in about 71 minutes */
+uint32_t timer_read_us(void);
 
 #ifdef __cplusplus
 }
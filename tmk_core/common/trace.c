@@ -0,0 +1,96 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include "timer.h"
+#include "host.h"
+#include "sendchar.h"
+#include "ring_buffer.h"
+#include "trace.h"
+
+
+/*
+ * Record on console
+ *
+ * 56 bits of record(id, time, a, b in little endian) are sent in ten bytes
+ * of 6 bits from LSB. First byte is 0b11xxxxxx and the rest 0b10xxxxxx, so
+ * records are told from text of print() and zero padding of console
+ * packet, and decoder can resync at next record after garbage.
+ */
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE   32      // power of 2, holds 31 records
+#endif
+#ifndef TRACE_BURST
+#define TRACE_BURST         3       // records per ms, 30 bytes fit in a console packet
+#endif
+
+typedef struct {
+    uint8_t id;
+    uint16_t time;
+    uint16_t a;
+    uint16_t b;
+} __attribute__ ((packed)) trace_record_t;
+
+RING_BUFFER(trace_buf, trace_record_t, TRACE_BUFFER_SIZE)
+
+
+void trace_write(uint8_t id, uint16_t a, uint16_t b)
+{
+    trace_buf_enqueue((trace_record_t){ .id = id, .time = timer_read(), .a = a, .b = b });
+}
+
+static void send_record(trace_record_t *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint16_t acc = 0;
+    uint8_t bits = 0;
+    uint8_t head = 0xC0;
+
+    for (uint8_t i = 0; i < sizeof(trace_record_t); i++) {
+        acc |= (uint16_t)p[i] << bits;
+        bits += 8;
+        while (bits >= 6) {
+            sendchar(head | (acc & 0x3F));
+            head = 0x80;
+            acc >>= 6;
+            bits -= 6;
+        }
+    }
+    if (bits) sendchar(0x80 | (acc & 0x3F));
+}
+
+void trace_task(void)
+{
+    static uint16_t last;
+
+    if (!trace_buf_has_data() && !trace_buf_dropped) return;
+    if (!host_get_driver()) return;
+
+    // limit rate to what host polls so that sendchar() doesn't wait
+    uint16_t now = timer_read();
+    if (now == last) return;
+    last = now;
+
+    for (uint8_t i = 0; i < TRACE_BURST && trace_buf_has_data(); i++) {
+        trace_record_t r = trace_buf_dequeue();
+        send_record(&r);
+    }
+    if (!trace_buf_has_data() && trace_buf_dropped) {
+        trace_record_t r = { .id = TRACE_LOST, .time = now, .a = trace_buf_dropped, .b = 0 };
+        send_record(&r);
+        trace_buf_dropped = 0;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "print.h"
+#include "debug.h"
+
+
+/*
+ * Binary event trace
+ *
+ * trace() stores event ID, 16-bit time in ms and two 16-bit arguments in
+ * RAM ring instead of formatting text, and trace_task() streams records on
+ * console a few per millisecond so that console never blocks main loop.
+ * tool/trace decodes them with table of trace_events.h made by build.
+ *
+ * Records are taken while debug is enabled(Magic+d). Call from main loop
+ * only, not from ISR.
+ *
+ * Enable with TRACE_ENABLE = yes in Makefile. trace_xprintf() and
+ * trace_dprintf() are replacements of xprintf() and dprintf() in hot path,
+ * they make a record with TRACE_ENABLE and print text without it.
+ */
+enum trace_id {
+#define TRACE_EVENT(name, format)   name,
+#include "trace_events.h"
+#undef TRACE_EVENT
+    TRACE_EVENTS
+};
+
+#ifdef TRACE_ENABLE
+void trace_write(uint8_t id, uint16_t a, uint16_t b);
+void trace_task(void);
+
+#define trace(id, a, b)                 do { if (debug_enable) trace_write(id, a, b); } while (0)
+#define trace_xprintf(id, a, b, ...)    trace_write(id, a, b)
+#define trace_dprintf(id, a, b, ...)    trace(id, a, b)
+#else
+#define trace(id, a, b)
+#define trace_task()
+#define trace_xprintf(id, a, b, ...)    xprintf(__VA_ARGS__)
+#define trace_dprintf(id, a, b, ...)    dprintf(__VA_ARGS__)
+#endif
+
+#endif
@@ -0,0 +1,43 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * Trace events
+ *
+ * TRACE_EVENT(name, format)
+ *
+ * ID of event is its position in this list, so keep the list free of
+ * conditionals. Format is used only by host decoder(tool/trace) and given
+ * two arguments of the record, it can have up to two integer conversions.
+ *
+ * This is expanded into enum trace_id in trace.h and into table file
+ * $(TARGET).trace by firmware build(-DTRACE_TABLE).
+ */
+#ifdef TRACE_TABLE
+#define TRACE_EVENT(name, format)   name format
+#endif
+
+TRACE_EVENT(TRACE_LOST,         "lost %u records")
+TRACE_EVENT(TRACE_MARK,         "mark %u %u")
+TRACE_EVENT(TRACE_KEY,          "key %04X pressed:%u")
+TRACE_EVENT(TRACE_ACTION,       "action %04X pressed:%u")
+TRACE_EVENT(TRACE_TAPPING,      "tapping key:%04X count:%u")
+TRACE_EVENT(TRACE_TAPPING_OVERFLOW, "tapping: waiting buffer overflow")
+TRACE_EVENT(TRACE_KEYBOARD,     "keyboard report %04X %04X")
+TRACE_EVENT(TRACE_KEYBOARD_CONT, "                %04X %04X")
+TRACE_EVENT(TRACE_SCAN_CODE,    "scan code %02X state:%u")
+TRACE_EVENT(TRACE_SCAN_ERROR,   "scan code error %02X state:%u")
+TRACE_EVENT(TRACE_SCAN_OVERRUN, "scan code overrun")
@@ -41,6 +41,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "adb.h"
+#ifdef ADB_INT_VECT
+#include "edge_timer.h"
+#endif
 
 
 // GCC doesn't inline functions normally
@@ -61,6 +64,12 @@ static inline void send_byte(uint8_t data);
 static inline uint16_t wait_data_lo(uint16_t us);
 static inline uint16_t wait_data_hi(uint16_t us);
 
+static bool srq = false;
+
+#ifdef ADB_INT_VECT
+static uint16_t talk_response(void);
+#endif
+
 
 void adb_host_init(void)
 {
@@ -78,6 +87,13 @@ bool adb_host_psw(void)
 }
 #endif
 
+/* Service Request seen on stop bit of last Talk: some device other than
+ * the addressed one has data to send. */
+bool adb_host_srq(void)
+{
+    return srq;
+}
+
 /*
  * Don't call this in a row without the delay, otherwise it makes some of poor controllers
  * overloaded and misses strokes. Recommended interval is 12ms.
@@ -104,12 +120,16 @@ uint16_t adb_host_mouse_recv(void)
 
 uint16_t adb_host_talk(uint8_t addr, uint8_t reg)
 {
-    uint16_t data = 0;
     cli();
     attention();
     send_byte((addr<<4) | (ADB_CMD_TALK<<2) | reg);
     place_bit0();               // Stopbit(0)
-    if (!wait_data_hi(500)) {    // Service Request(310us Adjustable Keyboard): just ignored
+    srq = !data_in();           // device holds stop bit low for Service Request
+#ifdef ADB_INT_VECT
+    return talk_response();
+#else
+    uint16_t data = 0;
+    if (!wait_data_hi(500)) {    // Service Request(310us Adjustable Keyboard)
         sei();
         return -30;             // something wrong
     }
@@ -154,7 +174,108 @@ uint16_t adb_host_talk(uint8_t addr, uint8_t reg)
 error:
     sei();
     return -n;
+#endif
+}
+
+#ifdef ADB_INT_VECT
+/*
+ * Talk response with pin interrupt
+ *
+ * Edges on data line are time stamped by ISR with Timer0(4us at 16MHz) and
+ * cells are decoded after the response is over, interrupts are enabled
+ * while device sends. Cell: falling edge, low(bit1:35us, bit0:65us), rising
+ * edge and high for rest of 100us.
+ *
+ * Edge can be stamped late by other ISRs(Timer0, USB), which moves low time
+ * of a cell toward its middle; USB SOF interrupt is masked during response.
+ * Cell has to be 100us+-30% and its low under 45% for bit1 or over 55% for
+ * bit0, a cell in between is an error rather than a guessed bit.
+ */
+#define ADB_EDGES           40
+#define ADB_RESPONSE_EDGES  36      // start bit, 16 data bits and stop bit
+#define ADB_CELL_MIN        EDGE_TIMER_TICKS(70)
+#define ADB_CELL_MAX        EDGE_TIMER_TICKS(130)
+
+static edge_time_t edge[ADB_EDGES];
+static volatile uint8_t edge_count;
+
+ISR(ADB_INT_VECT)
+{
+    uint8_t n = edge_count;
+    if (n < ADB_EDGES) {
+        edge_stamp(&edge[n]);
+        edge_count = n + 1;
+    }
+}
+
+/* Called after stop bit of Talk command with interrupts disabled */
+static uint16_t talk_response(void)
+{
+    edge_time_t start, now;
+
+    edge_count = 0;
+#ifdef UDIEN
+    // USB SOF ISR(console flush) is longest latency, it can wait for 2.5ms
+    uint8_t udien = UDIEN;
+    UDIEN &= ~(1<<SOFE);
+#endif
+    ADB_INT_ON();
+    uint8_t first = srq ? 1 : 0;    // release of Service Request
+    edge_stamp(&start);
+    sei();
+
+    for (;;) {
+        uint8_t n = edge_count;
+        if (n >= first + ADB_RESPONSE_EDGES) break;
+
+        cli();
+        edge_stamp(&now);
+        sei();
+        if (n < first) {
+            // Service Request(310us Adjustable Keyboard)
+            if (edge_ticks(&start, &now) > EDGE_TIMER_TICKS(500)) break;
+        } else if (n == first) {
+            // Tlt/Stop to Start(140-260us)
+            if (edge_ticks(first ? &edge[0] : &start, &now) > EDGE_TIMER_TICKS(500)) break;
+        } else {
+            // lost edge
+            if (edge_ticks(&edge[n - 1], &now) > EDGE_TIMER_TICKS(200)) break;
+        }
+    }
+    ADB_INT_OFF();
+#ifdef UDIEN
+    UDIEN = udien;
+#endif
+
+    uint8_t n = edge_count;
+    if (n < first) return -30;      // something wrong
+    if (n == first) return 0;       // No data to send
+
+    uint16_t data = 0;
+    edge_time_t *e = &edge[first];
+    n -= first;
+    for (uint8_t cell = 0; cell < 17; cell++, e += 2) {
+        if (n < cell * 2 + 3) return -(17 - cell);
+
+        uint16_t lo = edge_ticks(&e[0], &e[1]);
+        uint16_t len = edge_ticks(&e[0], &e[2]);
+        if (len < ADB_CELL_MIN || len > ADB_CELL_MAX) return -(17 - cell);
+
+        data <<= 1;
+        if (lo * 20 < len * 9) {
+            data |= 1;
+        } else if (lo * 20 <= len * 11) {
+            return -(17 - cell);    // neither bit1 nor bit0
+        } else if (cell == 0) {
+            return -20;             // start bit must be 1
+        }
+    }
+
+    // low of stop bit(can be lengthened by Service Request)
+    if (n < ADB_RESPONSE_EDGES) return -21;
+    return data;
 }
+#endif
 
 void adb_host_listen(uint8_t addr, uint8_t reg, uint8_t data_h, uint8_t data_l)
 {
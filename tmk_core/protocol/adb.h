@@ -82,6 +82,7 @@ POSSIBILITY OF SUCH DAMAGE.
 // ADB host
 void     adb_host_init(void);
 bool     adb_host_psw(void);
+bool     adb_host_srq(void);
 uint16_t adb_host_kbd_recv(uint8_t addr);
 uint16_t adb_host_mouse_recv(void);
 uint16_t adb_host_talk(uint8_t addr, uint8_t reg);
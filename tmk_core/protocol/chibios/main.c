@@ -36,6 +36,7 @@
 #endif
 #include "suspend.h"
 #include "hook.h"
+#include "timer.h"
 
 
 /* -------------------------
@@ -116,34 +117,37 @@ int main(void) {
   /* init printf */
   init_printf(NULL,sendchar_pf);
 
-  /* Wait until the USB is active */
-  while(USB_DRIVER.state != USB_ACTIVE)
-    chThdSleepMilliseconds(50);
-
-  /* Do need to wait here!
-   * Otherwise the next print might start a transfer on console EP
-   * before the USB is completely ready, which sometimes causes
-   * HardFaults.
-   */
-  chThdSleepMilliseconds(50);
-
-  print("USB configured.\n");
-
-  /* init TMK modules */
+  /* init TMK modules while host enumerates device,
+   * key events are queued in keyboard_task() until host driver is set. */
   keyboard_init();
-  host_set_driver(&chibios_driver);
 
 #ifdef SLEEP_LED_ENABLE
   sleep_led_init();
 #endif
 
-  print("Keyboard start.\n");
-
   hook_late_init();
 
   /* Main loop */
+  uint16_t active_at = 0;
   while(true) {
 
+    if(!host_get_driver()) {
+      if(USB_DRIVER.state != USB_ACTIVE) {
+        active_at = 0;
+      } else if(!active_at) {
+        active_at = timer_read() | 1;
+      } else if(timer_elapsed(active_at) > 50) {
+        /* Do need to wait 50ms after USB gets active!
+         * Otherwise the next print might start a transfer on console EP
+         * before the USB is completely ready, which sometimes causes
+         * HardFaults.
+         */
+        printf("USB configured: %lums\n", timer_read32());
+        host_set_driver(&chibios_driver);
+        print("Keyboard start.\n");
+      }
+    }
+
     if(USB_DRIVER.state == USB_SUSPENDED) {
       print("[s]");
       while(USB_DRIVER.state == USB_SUSPENDED) {
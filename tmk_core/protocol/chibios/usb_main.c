@@ -28,6 +28,7 @@
 #include "led.h"
 #endif
 #include "hook.h"
+#include "latency.h"
 
 /* TMK hooks */
 __attribute__((weak))
@@ -1066,17 +1067,17 @@ void send_remote_wakeup(USBDriver *usbp) {
 
 /* keyboard IN callback hander (a kbd report has made it IN) */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
   (void)usbp;
   (void)ep;
+  latency_sent();
 }
 
 #ifdef NKRO_ENABLE
 /* nkro IN callback hander (a nkro report has made it IN) */
 void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
   (void)usbp;
   (void)ep;
+  latency_sent();
 }
 #endif /* NKRO_ENABLE */
 
@@ -0,0 +1,83 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EDGE_TIMER_H
+#define EDGE_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include "timer.h"
+
+/*
+ * Inter-edge timing for interrupt driven receivers(PS/2, XT, IBM4704)
+ *
+ * Clock edges in a frame come every bit period. When the time from previous
+ * edge exceeds the limit the receiver has lost an edge or caught a glitch,
+ * the partial frame is dropped and state machine starts over from next edge.
+ *
+ * Time is read from Timer0 of common/avr/timer.c, its resolution is
+ * 1/TIMER_RAW_FREQ(4us at 16MHz). This must be called in ISR.
+ */
+#define EDGE_TIMER_TICKS(us)    ((uint16_t)((uint32_t)(us) * TIMER_RAW_FREQ / 1000000))
+
+typedef struct {
+    uint8_t ms;
+    uint8_t raw;
+} edge_time_t;
+
+typedef struct {
+    uint16_t error;     // framing/parity error
+    uint16_t resync;    // partial frame dropped by timeout
+} edge_stats_t;
+
+
+/* Records time of this edge and returns true if time from last edge exceeds
+ * 'ticks'. Longer than 1ms is always timeout. */
+static inline bool edge_timeout(edge_time_t *last, uint16_t ticks)
+{
+    uint8_t ms = timer_count;
+    uint8_t raw = TIMER_RAW;
+    // compare match pending while interrupts are disabled in ISR
+    if ((TIFR0 & (1<<OCF0A)) && raw < TIMER_RAW_TOP/2) ms++;
+
+    uint8_t elapsed_ms = ms - last->ms;
+    int16_t elapsed = (int16_t)raw - last->raw;
+    last->ms = ms;
+    last->raw = raw;
+
+    if (elapsed_ms > 1) return true;
+    if (elapsed_ms == 1) elapsed += TIMER_RAW_TOP + 1;
+    return (elapsed > (int16_t)ticks);
+}
+
+/* Time stamp for edge_ticks(). Call in ISR or with interrupts disabled. */
+static inline void edge_stamp(edge_time_t *t)
+{
+    uint8_t ms = timer_count;
+    uint8_t raw = TIMER_RAW;
+    if ((TIFR0 & (1<<OCF0A)) && raw < TIMER_RAW_TOP/2) ms++;
+    t->ms = ms;
+    t->raw = raw;
+}
+
+/* Ticks from 'from' to 'to', they must be less than 256ms apart. */
+static inline uint16_t edge_ticks(const edge_time_t *from, const edge_time_t *to)
+{
+    return (uint8_t)(to->ms - from->ms) * (uint16_t)(TIMER_RAW_TOP + 1) + to->raw - from->raw;
+}
+
+#endif
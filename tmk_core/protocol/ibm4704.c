@@ -5,6 +5,7 @@ Copyright 2010,2011,2012,2013 Jun WAKO <wakojun@gmail.com>
 #include <util/delay.h>
 #include "debug.h"
 #include "ring_buffer.h"
+#include "edge_timer.h"
 #include "ibm4704.h"
 
 
@@ -18,6 +19,9 @@ Copyright 2010,2011,2012,2013 Jun WAKO <wakojun@gmail.com>
 
 uint8_t ibm4704_error = 0;
 
+RING_BUFFER(rbuf, uint8_t, 32)
+edge_stats_t ibm4704_stats;
+
 
 void ibm4704_init(void)
 {
@@ -139,9 +143,18 @@ ISR(IBM4704_INT_VECT)
     static uint8_t data = 0;
     // Odd parity
     static uint8_t parity = false;
+    static edge_time_t last;
 
     ibm4704_error = 0;
 
+    // abort frame if elapse IBM4704_EDGE_TIMEOUT from previous rising edge
+    if (edge_timeout(&last, EDGE_TIMER_TICKS(IBM4704_EDGE_TIMEOUT)) && state != BIT0) {
+        ibm4704_stats.resync++;
+        state = BIT0;
+        data = 0;
+        parity = false;
+    }
+
     switch (state) {
         case BIT0:
         case BIT1:
@@ -178,6 +191,7 @@ ISR(IBM4704_INT_VECT)
     goto RETURN;
 ERROR:
     ibm4704_error = state;
+    ibm4704_stats.error++;
     while (ibm4704_send(0xFE)) _delay_ms(1); // resend
     xprintf("R:%02X%02X\n", state, data);
 DONE:
@@ -187,3 +201,10 @@ DONE:
 RETURN:
     return;
 }
+
+void ibm4704_print_stats(void)
+{
+    ring_buffer_stats_t b = rbuf_stats();
+    xprintf("ibm4704: dropped:%u high:%u/%u error:%u resync:%u\n",
+            b.dropped, b.high, b.size, ibm4704_stats.error, ibm4704_stats.resync);
+}
@@ -4,14 +4,25 @@ Copyright 2014 Jun WAKO <wakojun@gmail.com>
 #ifndef IBM4704_H
 #define IBM4704_H
 
+#include "edge_timer.h"
+
 #define IBM4704_ERR_NONE        0
 #define IBM4704_ERR_PARITY      0x70
 
+/* Clock has around 60us high and 30us low part, longer gap between rising
+ * edges means lost edge or glitch. */
+#ifndef IBM4704_EDGE_TIMEOUT
+#define IBM4704_EDGE_TIMEOUT    200
+#endif
+
 
 void ibm4704_init(void);
 uint8_t ibm4704_send(uint8_t data);
 uint8_t ibm4704_recv_response(void);
 uint8_t ibm4704_recv(void);
+void ibm4704_print_stats(void);
+
+extern edge_stats_t ibm4704_stats;
 
 
 /* Check pin configuration */
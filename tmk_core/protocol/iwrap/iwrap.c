@@ -267,12 +267,20 @@ void iwrap_sleep(void)
     iwrap_mux_send("SLEEP");
 }
 
+/* Link mode commands for first connection(link ID 0) */
+void iwrap_active(void)
+{
+    iwrap_mux_send("ACTIVE 0");
+}
+
 void iwrap_sniff(void)
 {
+    iwrap_mux_send("SNIFF 0 " IWRAP_SNIFF_PARAM);
 }
 
 void iwrap_subrate(void)
 {
+    iwrap_mux_send("SSR 0 " IWRAP_SUBRATE_PARAM);
 }
 
 bool iwrap_failed(void)
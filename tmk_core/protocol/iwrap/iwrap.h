@@ -27,6 +27,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MUX_MODE
 
 
+/* SNIFF <max> <min> <attempt> <timeout>: interval in 0.625ms slots, 10ms */
+#ifndef IWRAP_SNIFF_PARAM
+#define IWRAP_SNIFF_PARAM       "16 16 1 8"
+#endif
+/* SSR <max latency> <min remote timeout> <min local timeout>: 100ms */
+#ifndef IWRAP_SUBRATE_PARAM
+#define IWRAP_SUBRATE_PARAM     "160 0 0"
+#endif
+
+
 host_driver_t *iwrap_driver(void);
 
 void iwrap_init(void);
@@ -40,6 +50,7 @@ void iwrap_call(void);
 void iwrap_kill(void);
 void iwrap_unpair(void);
 void iwrap_sleep(void);
+void iwrap_active(void);
 void iwrap_sniff(void);
 void iwrap_subrate(void);
 bool iwrap_failed(void);
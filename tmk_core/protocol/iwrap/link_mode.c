@@ -0,0 +1,61 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "iwrap.h"
+#include "link_mode.h"
+
+
+static uint8_t mode = LINK_ACTIVE;
+
+/* Link is in active mode on connection */
+void link_mode_reset(void)
+{
+    mode = LINK_ACTIVE;
+}
+
+uint8_t link_mode_task(uint32_t idle)
+{
+    uint8_t next;
+    if (idle < LINK_SNIFF_IDLE) {
+        next = LINK_ACTIVE;
+    } else if (idle < LINK_SUBRATE_IDLE) {
+        next = LINK_SNIFF;
+    } else {
+        next = LINK_SUBRATE;
+    }
+    if (next == mode) return mode;
+
+    switch (next) {
+        case LINK_ACTIVE:
+            iwrap_active();
+            break;
+        case LINK_SNIFF:
+            // from active only; key activity always goes back to active
+            iwrap_sniff();
+            break;
+        case LINK_SUBRATE:
+            if (mode == LINK_ACTIVE) iwrap_sniff();
+            iwrap_subrate();
+            break;
+    }
+    mode = next;
+    return mode;
+}
+
+uint8_t link_mode(void)
+{
+    return mode;
+}
@@ -0,0 +1,50 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LINK_MODE_H
+#define LINK_MODE_H
+
+#include <stdint.h>
+
+/*
+ * Bluetooth link mode controller
+ *
+ * Link is kept in active mode while typing for minimum latency, and put in
+ * sniff mode and then sniff subrating after idle periods.
+ *
+ *   ACTIVE  --(LINK_SNIFF_IDLE)-->  SNIFF  --(LINK_SUBRATE_IDLE)-->  SUBRATE
+ *      ^                              |                                |
+ *      +--------- key activity -------+--------------------------------+
+ */
+#ifndef LINK_SNIFF_IDLE
+#define LINK_SNIFF_IDLE     500     // ms
+#endif
+#ifndef LINK_SUBRATE_IDLE
+#define LINK_SUBRATE_IDLE   3000    // ms, before MCU sleeps at 4s idle
+#endif
+
+enum link_mode {
+    LINK_ACTIVE = 0,
+    LINK_SNIFF,
+    LINK_SUBRATE,
+};
+
+void link_mode_reset(void);
+/* idle: ms from last matrix activity */
+uint8_t link_mode_task(uint32_t idle);
+uint8_t link_mode(void);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host simulation of link mode controller
+ *
+ * link_mode.c runs against fake iWRAP UART and a typing trace, and latency
+ * of key reports and average radio current are estimated from the link
+ * mode at each report. Idle periods are taken from link_mode.h and can be
+ * overridden on command line.
+ *
+ *   gcc -I../../common -DLINK_SNIFF_IDLE=500 -o link_sim link_sim.c link_mode.c
+ *   ./link_sim [-v] [seconds]
+ *
+ * Sniff interval and subrate latency should match IWRAP_SNIFF_PARAM and
+ * IWRAP_SUBRATE_PARAM. Current is rough figure of PowerSave.txt notes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iwrap.h"
+#include "link_mode.h"
+
+
+#define SLOT_US         625
+#define SNIFF_US        (16 * SLOT_US)      // SNIFF 0 16 16
+#define SUBRATE_US      (160 * SLOT_US)     // SSR 0 160
+#define CURRENT_ACTIVE  25.0                // mA
+#define CURRENT_SNIFF   3.0
+#define CURRENT_SUBRATE 1.5
+
+static bool verbose = false;
+static uint32_t now;        // ms
+static uint8_t link = LINK_ACTIVE;
+static uint32_t commands = 0;
+
+
+/* Fake UART: iWRAP commands are logged and applied to link */
+void iwrap_mux_send(const char *s)
+{
+    commands++;
+    if (verbose) printf("%8u.%03u UART: %s\n", now/1000, now%1000, s);
+}
+
+void iwrap_active(void)  { iwrap_mux_send("ACTIVE 0"); link = LINK_ACTIVE; }
+void iwrap_sniff(void)   { iwrap_mux_send("SNIFF 0 " IWRAP_SNIFF_PARAM); link = LINK_SNIFF; }
+void iwrap_subrate(void) { iwrap_mux_send("SSR 0 " IWRAP_SUBRATE_PARAM); link = LINK_SUBRATE; }
+
+
+/* Typing trace: bursts of keystrokes separated by pauses */
+static uint32_t rnd(uint32_t max)
+{
+    static uint32_t x = 2463534242UL;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return x % max;
+}
+
+static uint32_t next_key(uint32_t t)
+{
+    static uint32_t burst = 0;
+    if (burst) {
+        burst--;
+        return t + 60 + rnd(200);           // 60-260ms between keys
+    }
+    burst = 5 + rnd(100);
+    switch (rnd(4)) {
+        case 0:  return t + 300 + rnd(700);     // short pause
+        case 1:  return t + 1000 + rnd(4000);   // thinking
+        default: return t + 5000 + rnd(55000);  // away
+    }
+}
+
+/* Time to next anchor point of link in us */
+static uint32_t latency_us(uint8_t mode, uint32_t t_us)
+{
+    switch (mode) {
+        case LINK_SNIFF:   return SNIFF_US - t_us % SNIFF_US + 2 * SLOT_US;
+        case LINK_SUBRATE: return SUBRATE_US - t_us % SUBRATE_US + 2 * SLOT_US;
+        default:           return 2 * SLOT_US;
+    }
+}
+
+static int cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = 3600;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) verbose = true;
+        else seconds = strtoul(argv[i], NULL, 10);
+    }
+
+    uint32_t end = seconds * 1000;
+    uint32_t *lat = malloc(sizeof(uint32_t) * end / 60 + 1);
+    uint32_t nkeys = 0;
+    uint32_t in_mode[3] = { 0 };
+    uint32_t last_activity = 0;
+    uint32_t key = next_key(0);
+
+    link_mode_reset();
+    for (now = 0; now < end; now++) {
+        if (now == key) {
+            // report waits for anchor point of current link mode
+            lat[nkeys++] = latency_us(link, now * 1000);
+            last_activity = now;
+            key = next_key(now);
+        }
+        link_mode_task(now - last_activity);
+        in_mode[link]++;
+    }
+
+    qsort(lat, nkeys, sizeof(uint32_t), cmp);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < nkeys; i++) sum += lat[i];
+    double current = (CURRENT_ACTIVE * in_mode[LINK_ACTIVE] +
+                      CURRENT_SNIFF * in_mode[LINK_SNIFF] +
+                      CURRENT_SUBRATE * in_mode[LINK_SUBRATE]) / end;
+
+    printf("idle: sniff %ums, subrate %ums\n", LINK_SNIFF_IDLE, LINK_SUBRATE_IDLE);
+    printf("keys: %u, commands: %u\n", nkeys, commands);
+    if (nkeys) {
+        printf("latency: mean %.2fms, p50 %.2fms, p99 %.2fms, max %.2fms\n",
+               sum / 1000.0 / nkeys, lat[nkeys/2] / 1000.0,
+               lat[nkeys*99/100] / 1000.0, lat[nkeys-1] / 1000.0);
+    }
+    printf("time: active %.1f%%, sniff %.1f%%, subrate %.1f%%\n",
+           100.0 * in_mode[LINK_ACTIVE] / end, 100.0 * in_mode[LINK_SNIFF] / end,
+           100.0 * in_mode[LINK_SUBRATE] / end);
+    printf("current: %.2fmA\n", current);
+    free(lat);
+    return 0;
+}
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "action.h"
 #include "iwrap.h"
+#include "link_mode.h"
 #ifdef PROTOCOL_VUSB
 #   include "vusb.h"
 #   include "usbdrv.h"
@@ -124,6 +125,7 @@ void change_driver(host_driver_t *driver)
 static bool sleeping = false;
 static bool insomniac = false;   // TODO: should be false for power saving
 static uint16_t last_timer = 0;
+static uint32_t last_activity = 0;
 
 int main(void)
 {
@@ -175,12 +177,20 @@ int main(void)
         // TODO: depricated
         if (matrix_is_modified() || console()) {
             last_timer = timer_read();
+            last_activity = timer_read32();
             sleeping = false;
         } else if (!sleeping && timer_elapsed(last_timer) > 4000) {
             sleeping = true;
             iwrap_check_connection();
         }
 
+        // link mode by matrix activity
+        if (iwrap_connected()) {
+            link_mode_task(timer_elapsed32(last_activity));
+        } else {
+            link_mode_reset();
+        }
+
         // TODO: suspend.h
         if (host_get_driver() == iwrap_driver()) {
             if (sleeping && !insomniac) {
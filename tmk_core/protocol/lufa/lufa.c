@@ -49,6 +49,8 @@
 #endif
 #include "suspend.h"
 #include "hook.h"
+#include "timer.h"
+#include "latency.h"
 
 #include "descriptor.h"
 #include "lufa.h"
@@ -421,6 +423,26 @@ static void send_keyboard(report_keyboard_t *report)
     keyboard_report_sent = *report;
 }
 
+#ifdef LATENCY_ENABLE
+/* Bank is released when host has read the report */
+static void latency_poll(void)
+{
+    if (!latency_waiting()) return;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keyboard_nkro)
+        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
+    else
+#endif
+        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
+    if (Endpoint_IsINReady()) {
+        latency_sent();
+    }
+    Endpoint_SelectEndpoint(ep);
+}
+#endif
+
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
@@ -590,32 +612,31 @@ int main(void)
     setup_usb();
     sei();
 
-    /* wait for USB startup & debug output */
-    while (USB_DeviceState != DEVICE_STATE_Configured) {
-#if defined(INTERRUPT_CONTROL_ENDPOINT)
-        ;
-#else
-        USB_USBTask();
-#endif
-    }
-    print("USB configured.\n");
-
-    /* init modules */
+    /* init modules while host enumerates device, control requests are
+     * served in ISR(INTERRUPT_CONTROL_ENDPOINT) meanwhile.
+     * key events are queued in keyboard_task() until host driver is set. */
     keyboard_init();
-    host_set_driver(&lufa_driver);
 #ifdef SLEEP_LED_ENABLE
     sleep_led_init();
 #endif
-
-    print("Keyboard start.\n");
     hook_late_init();
+
     while (1) {
         while (USB_DeviceState == DEVICE_STATE_Suspended) {
             print("[s]");
             hook_usb_suspend_loop();
         }
 
+        if (!host_get_driver() && USB_DeviceState == DEVICE_STATE_Configured) {
+            xprintf("USB configured: %lums\n", timer_read32());
+            host_set_driver(&lufa_driver);
+            print("Keyboard start.\n");
+        }
+
         keyboard_task();
+#ifdef LATENCY_ENABLE
+        latency_poll();
+#endif
 
 #if !defined(INTERRUPT_CONTROL_ENDPOINT)
         USB_USBTask();
@@ -39,6 +39,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "news.h"
+#include "ring_buffer.h"
+#include "print.h"
 
 
 void news_init(void)
@@ -47,31 +49,17 @@ void news_init(void)
 }
 
 // RX ring buffer
-#define RBUF_SIZE   8
-static uint8_t rbuf[RBUF_SIZE];
-static uint8_t rbuf_head = 0;
-static uint8_t rbuf_tail = 0;
+RING_BUFFER(rbuf, uint8_t, 8)
 
 uint8_t news_recv(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
-        return 0;
-    }
-
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
-    return data;
+    return rbuf_dequeue();
 }
 
 // USART RX complete interrupt
 ISR(NEWS_KBD_RX_VECT)
 {
-    uint8_t next = (rbuf_head + 1) % RBUF_SIZE;
-    if (next != rbuf_tail) {
-        rbuf[rbuf_head] = NEWS_KBD_RX_DATA;
-        rbuf_head = next;
-    }
+    rbuf_enqueue(NEWS_KBD_RX_DATA);
 }
 
 
@@ -166,3 +154,9 @@ Scan Codes
     | 43  | 44 | 45 |       46          |    47    | 48| 49|  4A  | | 6E| | 66| 5B| 5C| 5D|
     `-------------------------------------------------------------' `---' `---------------'
 */
+
+void news_print_stats(void)
+{
+    ring_buffer_stats_t b = rbuf_stats();
+    xprintf("news: dropped:%u high:%u/%u\n", b.dropped, b.high, b.size);
+}
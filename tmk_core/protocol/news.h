@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 /* host role */
 void news_init(void);
 uint8_t news_recv(void);
+void news_print_stats(void);
 
 /* device role */
 
@@ -42,6 +42,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "wait.h"
 #include "ps2_io.h"
 #include "print.h"
+#ifdef PS2_USE_INT
+#include "edge_timer.h"
+#endif
 
 /*
  * Primitive PS/2 Library for AVR
@@ -69,6 +72,7 @@ POSSIBILITY OF SUCH DAMAGE.
  */
 #define PS2_ACK         0xFA
 #define PS2_RESEND      0xFE
+#define PS2_ERROR       0xFC
 #define PS2_SET_LED     0xED
 
 // TODO: error numbers
@@ -83,14 +87,39 @@ POSSIBILITY OF SUCH DAMAGE.
 #define PS2_LED_NUM_LOCK    1
 #define PS2_LED_CAPS_LOCK   2
 
+/* Clock period is 60-100us([2]p.13), longer gap between falling edges
+ * means lost edge or glitch. Used by ps2_interrupt.c */
+#ifndef PS2_EDGE_TIMEOUT
+#define PS2_EDGE_TIMEOUT    200
+#endif
+
+/* Asynchronous send of ps2_interrupt.c, queue size is 8 at most */
+#ifndef PS2_TX_QUEUE_SIZE
+#define PS2_TX_QUEUE_SIZE   4
+#endif
+#ifndef PS2_TX_TIMEOUT
+#define PS2_TX_TIMEOUT      40  // ms
+#endif
+#ifndef PS2_TX_RETRY
+#define PS2_TX_RETRY        2
+#endif
+
 
 extern uint8_t ps2_error;
+#ifdef PS2_USE_INT
+extern edge_stats_t ps2_stats;
+#endif
 
 void ps2_host_init(void);
 uint8_t ps2_host_send(uint8_t data);
 uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
 void ps2_host_set_led(uint8_t usb_led);
+void ps2_host_print_stats(void);
+#ifdef PS2_USE_INT
+bool ps2_host_send_async(uint8_t data);
+void ps2_host_send_done(uint8_t data, uint8_t response);
+#endif
 
 
 /*--------------------------------------------------------------------
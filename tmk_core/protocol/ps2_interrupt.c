@@ -42,9 +42,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
-#include "pbuff.h"
+#include "ring_buffer.h"
 #include "ps2.h"
 #include "ps2_io.h"
+#include "edge_timer.h"
 #include "print.h"
 
 
@@ -57,6 +58,46 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 uint8_t ps2_error = PS2_ERR_NONE;
+edge_stats_t ps2_stats;
+
+RING_BUFFER(pbuf, uint8_t, 32)
+
+
+/*
+ * Asynchronous transmit
+ *
+ * Bits are put on data line by the falling edge ISR while device drives the
+ * clock, and ACK from device is caught by receiver before it goes to the
+ * buffer. Commands are queued and sent one by one from ps2_host_recv(),
+ * main loop spends only inhibit time(100us) per command.
+ */
+enum {
+    TX_IDLE = 0,
+    TX_INHIBIT,                 // host pulls clock low
+    TX_BIT0, TX_BIT1, TX_BIT2, TX_BIT3, TX_BIT4, TX_BIT5, TX_BIT6, TX_BIT7,
+    TX_PARITY,
+    TX_STOP,
+    TX_ACK,                     // device pulls data low
+    TX_RESPONSE,                // waiting for response
+    TX_DONE,
+};
+static volatile uint8_t tx_state = TX_IDLE;
+static uint8_t tx_data;
+static uint8_t tx_bits;         // shifted out by ISR
+static bool tx_parity;
+static volatile uint8_t tx_response;
+static uint16_t tx_time;
+static uint8_t tx_retry;
+
+static uint8_t tx_queue[PS2_TX_QUEUE_SIZE];
+static uint8_t tx_head = 0;
+static uint8_t tx_count = 0;
+static uint8_t tx_arg = 0;      // slots of argument, dropped when command fails
+
+static bool led_pending = false;
+static uint8_t led_state;
+
+static void tx_task(void);
 
 void ps2_host_init(void)
 {
@@ -70,6 +111,11 @@ void ps2_host_init(void)
 uint8_t ps2_host_send(uint8_t data)
 {
     bool parity = true;
+
+    // let queued commands finish, they time out by themselves
+    while (tx_count || tx_state != TX_IDLE) {
+        tx_task();
+    }
     ps2_error = PS2_ERR_NONE;
 
     PS2_INT_OFF();
@@ -136,6 +182,10 @@ uint8_t ps2_host_recv_response(void)
 /* get data received by interrupt */
 uint8_t ps2_host_recv(void)
 {
+    if (tx_count || tx_state != TX_IDLE) {
+        tx_task();
+    }
+
     if (pbuf_has_data()) {
         ps2_error = PS2_ERR_NONE;
         return pbuf_dequeue();
@@ -145,6 +195,48 @@ uint8_t ps2_host_recv(void)
     }
 }
 
+/* Called on falling edge while transmitting */
+static inline void tx_edge(void)
+{
+    switch (tx_state) {
+        case TX_INHIBIT:
+            // edge made by host itself
+            return;
+        case TX_BIT0:
+        case TX_BIT1:
+        case TX_BIT2:
+        case TX_BIT3:
+        case TX_BIT4:
+        case TX_BIT5:
+        case TX_BIT6:
+        case TX_BIT7:
+            if (tx_bits & 1) {
+                tx_parity = !tx_parity;
+                data_hi();
+            } else {
+                data_lo();
+            }
+            tx_bits >>= 1;
+            break;
+        case TX_PARITY:
+            if (tx_parity) { data_hi(); } else { data_lo(); }
+            break;
+        case TX_STOP:
+            data_hi();
+            break;
+        case TX_ACK:
+            if (data_in()) {
+                ps2_stats.error++;
+                tx_response = 0;
+                tx_state = TX_DONE;
+            } else {
+                tx_state = TX_RESPONSE;
+            }
+            return;
+    }
+    tx_state++;
+}
+
 ISR(PS2_INT_VECT)
 {
     static enum {
@@ -156,14 +248,26 @@ ISR(PS2_INT_VECT)
     } state = INIT;
     static uint8_t data = 0;
     static uint8_t parity = 1;
-
-    // TODO: abort if elapse 100us from previous interrupt
+    static edge_time_t last;
 
     // return unless falling edge
     if (clock_in()) {
         goto RETURN;
     }
 
+    if (tx_state >= TX_INHIBIT && tx_state <= TX_ACK) {
+        tx_edge();
+        goto RETURN;
+    }
+
+    // abort frame if elapse PS2_EDGE_TIMEOUT from previous falling edge
+    if (edge_timeout(&last, EDGE_TIMER_TICKS(PS2_EDGE_TIMEOUT)) && state != INIT) {
+        ps2_stats.resync++;
+        state = INIT;
+        data = 0;
+        parity = 1;
+    }
+
     state++;
     switch (state) {
         case START:
@@ -196,7 +300,13 @@ ISR(PS2_INT_VECT)
         case STOP:
             if (!data_in())
                 goto ERROR;
-            pbuf_enqueue(data);
+            if (tx_state == TX_RESPONSE &&
+                    (data == PS2_ACK || data == PS2_RESEND || data == PS2_ERROR)) {
+                tx_response = data;
+                tx_state = TX_DONE;
+            } else {
+                pbuf_enqueue(data);
+            }
             goto DONE;
             break;
         default:
@@ -205,6 +315,7 @@ ISR(PS2_INT_VECT)
     goto RETURN;
 ERROR:
     ps2_error = state;
+    ps2_stats.error++;
 DONE:
     state = INIT;
     data = 0;
@@ -213,9 +324,112 @@ RETURN:
     return;
 }
 
+static void tx_start(void)
+{
+    tx_bits = tx_data;
+    tx_parity = true;
+    tx_time = timer_read();
+
+    // edge of inhibit is ignored by ISR
+    tx_state = TX_INHIBIT;
+    inhibit();
+    _delay_us(100); // 100us [4]p.13, [5]p.50
+
+    /* 'Request to Send' and Start bit */
+    data_lo();
+    tx_state = TX_BIT0;
+    clock_hi();
+}
+
+static void tx_dequeue(void)
+{
+    tx_arg &= ~(1<<tx_head);
+    tx_head = (tx_head + 1) % PS2_TX_QUEUE_SIZE;
+    tx_count--;
+}
+
+static void tx_task(void)
+{
+    switch (tx_state) {
+        case TX_IDLE:
+            if (!tx_count) return;
+            tx_data = tx_queue[tx_head];
+            tx_retry = 0;
+            tx_start();
+            return;
+        case TX_DONE:
+            if (tx_response == PS2_RESEND && tx_retry < PS2_TX_RETRY) {
+                tx_retry++;
+                tx_start();
+                return;
+            }
+            break;
+        default:
+            // Device clocks in 15ms, response may take 25ms([3]p.21, [5]p.46)
+            if (timer_elapsed(tx_time) < PS2_TX_TIMEOUT) return;
+            // ISR must not see a transfer state after the lines are released
+            cli();
+            tx_response = 0;
+            idle();
+            tx_state = TX_IDLE;
+            sei();
+            break;
+    }
+
+    tx_dequeue();
+    tx_state = TX_IDLE;
+    if (tx_response != PS2_ACK) {
+        xprintf("PS/2 send: %02X response: %02X\n", tx_data, tx_response);
+        // argument without its command would be taken as command
+        if (tx_count && (tx_arg & (1<<tx_head))) {
+            xprintf("PS/2 send: %02X dropped\n", tx_queue[tx_head]);
+            tx_dequeue();
+        }
+    }
+    ps2_host_send_done(tx_data, tx_response);
+
+    if (led_pending) {
+        ps2_host_set_led(led_state);
+    }
+}
+
+/* Queues command byte to device, returns false when queue is full. */
+bool ps2_host_send_async(uint8_t data)
+{
+    if (tx_count == PS2_TX_QUEUE_SIZE) return false;
+    tx_queue[(tx_head + tx_count) % PS2_TX_QUEUE_SIZE] = data;
+    tx_count++;
+    tx_task();
+    return true;
+}
+
+/* Called with response of device when async command is done: ACK(FA),
+ * Resend(FE), Error(FC), or 0 for timeout. */
+__attribute__((weak))
+void ps2_host_send_done(uint8_t data, uint8_t response)
+{
+    (void)data;
+    (void)response;
+}
+
 /* send LED state to keyboard */
 void ps2_host_set_led(uint8_t led)
 {
-    ps2_host_send(0xED);
-    ps2_host_send(led);
+    // command and argument are queued together, or later when queue has room
+    if (PS2_TX_QUEUE_SIZE - tx_count < 2) {
+        led_pending = true;
+        led_state = led;
+        return;
+    }
+    led_pending = false;
+    ps2_host_send_async(0xED);
+    tx_arg |= 1<<((tx_head + tx_count) % PS2_TX_QUEUE_SIZE);
+    ps2_host_send_async(led);
+}
+
+void ps2_host_print_stats(void)
+{
+    ring_buffer_stats_t b = pbuf_stats();
+    xprintf("ps2: dropped:%u high:%u/%u error:%u resync:%u\n",
+            b.dropped, b.high, b.size, ps2_stats.error, ps2_stats.resync);
 }
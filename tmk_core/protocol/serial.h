@@ -43,5 +43,8 @@ void serial_init(void);
 uint8_t serial_recv(void);
 int16_t serial_recv2(void);
 void serial_send(uint8_t data);
+/* bytes serial_send() can take without waiting, UINT8_MAX when unbuffered */
+uint8_t serial_send_space(void);
+void serial_print_stats(void);
 
 #endif
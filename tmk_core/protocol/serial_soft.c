@@ -38,18 +38,64 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
 #include "serial.h"
+#include "ring_buffer.h"
+#include "print.h"
 
 /*
- *  Stupid Inefficient Busy-wait Software Serial
+ *  Timer driven Software Serial
  *  which is still useful for negative logic signal like Sun protocol
  *  if it is not supported by hardware UART.
  *
- *  TODO: delay is not accurate enough. Instruction cycle should be counted and inline assemby is needed.
+ *  A 16-bit timer runs free at F_CPU/8. Edge interrupt of start bit arms
+ *  compare channel A to sample RX at center of each bit, and compare
+ *  channel B shifts TX frames out of buffer. Neither send nor receive
+ *  waits in busy loop; serial_send() returns at once unless TX buffer is full.
+ *
+ *  Timer3 is used if MCU has it, otherwise Timer1(define SERIAL_SOFT_TIMER1
+ *  to use Timer1 on any MCU). Timer1 is also used by sleep_led.c.
  */
 
-#define WAIT_US     (1000000L/SERIAL_SOFT_BAUD)
+#if defined(TCCR3B) && !defined(SERIAL_SOFT_TIMER1)
+#   define TIMER_TCCRA      TCCR3A
+#   define TIMER_TCCRB      TCCR3B
+#   define TIMER_TCNT       TCNT3
+#   define TIMER_OCRA       OCR3A
+#   define TIMER_OCRB       OCR3B
+#   define TIMER_TIMSK      TIMSK3
+#   define TIMER_TIFR       TIFR3
+#   define TIMER_CS1        CS31
+#   define TIMER_OCIEA      OCIE3A
+#   define TIMER_OCIEB      OCIE3B
+#   define TIMER_OCFA       OCF3A
+#   define TIMER_OCFB       OCF3B
+#   define TIMER_COMPA_VECT TIMER3_COMPA_vect
+#   define TIMER_COMPB_VECT TIMER3_COMPB_vect
+#else
+#   define TIMER_TCCRA      TCCR1A
+#   define TIMER_TCCRB      TCCR1B
+#   define TIMER_TCNT       TCNT1
+#   define TIMER_OCRA       OCR1A
+#   define TIMER_OCRB       OCR1B
+#   define TIMER_TIMSK      TIMSK1
+#   define TIMER_TIFR       TIFR1
+#   define TIMER_CS1        CS11
+#   define TIMER_OCIEA      OCIE1A
+#   define TIMER_OCIEB      OCIE1B
+#   define TIMER_OCFA       OCF1A
+#   define TIMER_OCFB       OCF1B
+#   define TIMER_COMPA_VECT TIMER1_COMPA_vect
+#   define TIMER_COMPB_VECT TIMER1_COMPB_vect
+#endif
+
+/* timer ticks per bit */
+#define BIT_TICKS   ((uint16_t)((F_CPU/8 + SERIAL_SOFT_BAUD/2) / SERIAL_SOFT_BAUD))
+
+#ifdef SERIAL_SOFT_DATA_7BIT
+    #define DATA_BITS   7
+#else
+    #define DATA_BITS   8
+#endif
 
 #ifdef SERIAL_SOFT_LOGIC_NEGATIVE
     #define SERIAL_SOFT_RXD_IN()        !(SERIAL_SOFT_RXD_READ())
@@ -77,163 +123,206 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 
+/* RX ring buffer */
+RING_BUFFER(rbuf, uint8_t, 8)
+
+/* TX ring buffer */
+#ifndef SERIAL_SOFT_TX_BUFFER_SIZE
+#define SERIAL_SOFT_TX_BUFFER_SIZE  16
+#endif
+RING_BUFFER(tbuf, uint8_t, SERIAL_SOFT_TX_BUFFER_SIZE)
+
+/* RX frame in progress */
+static volatile bool rx_busy = false;
+static uint8_t rx_bit;
+static uint8_t rx_data;
+static uint8_t rx_parity;
+
+/* TX frame in progress: line levels LSB first, 1: ON */
+static volatile bool tx_busy = false;
+static uint16_t tx_frame;
+static uint8_t tx_bits;
+
+
 void serial_init(void)
 {
     SERIAL_SOFT_DEBUG_INIT();
 
+    // free running at F_CPU/8, compare interrupts are enabled on demand
+    TIMER_TCCRA = 0;
+    TIMER_TCCRB = (1<<TIMER_CS1);
+    TIMER_TIMSK &= ~((1<<TIMER_OCIEA) | (1<<TIMER_OCIEB));
+
     SERIAL_SOFT_RXD_INIT();
     SERIAL_SOFT_TXD_INIT();
 }
 
-/* RX ring buffer */
-#define RBUF_SIZE   8
-static uint8_t rbuf[RBUF_SIZE];
-static uint8_t rbuf_head = 0;
-static uint8_t rbuf_tail = 0;
-
-
 uint8_t serial_recv(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
-        return 0;
-    }
-
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
-    return data;
+    return rbuf_dequeue();
 }
 
 int16_t serial_recv2(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
+    if (!rbuf_has_data()) {
         return -1;
     }
-
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
-    return data;
+    return rbuf_dequeue();
 }
 
-void serial_send(uint8_t data)
+/* Line levels of frame: start, data, parity and stop bit */
+static uint16_t tx_frame_of(uint8_t data)
 {
-    /* signal state: IDLE: ON, START: OFF, STOP: ON, DATA0: OFF, DATA1: ON */
-
-#ifdef SERIAL_SOFT_BIT_ORDER_MSB
-    #ifdef SERIAL_SOFT_DATA_7BIT
-    uint8_t mask = 0x40;
-    #else
-    uint8_t mask = 0x80;
-    #endif
-#else
-    uint8_t mask = 0x01;
-#endif
-
+    uint16_t frame = 0;
+    uint8_t n = 1;      // start bit: OFF
     uint8_t parity = 0;
 
-    /* start bit */
-    SERIAL_SOFT_TXD_OFF();
-    _delay_us(WAIT_US);
-
-#ifdef SERIAL_SOFT_DATA_7BIT
-    while (mask&0x7F) {
+    for (uint8_t i = 0; i < DATA_BITS; i++) {
+#ifdef SERIAL_SOFT_BIT_ORDER_MSB
+        uint8_t bit = data & (1<<(DATA_BITS - 1 - i));
 #else
-    while (mask&0xFF) {
+        uint8_t bit = data & (1<<i);
 #endif
-        if (data&mask) {
-            SERIAL_SOFT_TXD_ON();
+        if (bit) {
+            frame |= (1<<n);
             parity ^= 1;
-        } else {
-            SERIAL_SOFT_TXD_OFF();
         }
-        _delay_us(WAIT_US);
+        n++;
+    }
 
-#ifdef SERIAL_SOFT_BIT_ORDER_MSB
-        mask >>= 1;
+#if defined(SERIAL_SOFT_PARITY_EVEN) || defined(SERIAL_SOFT_PARITY_ODD)
+    if (parity != SERIAL_SOFT_PARITY_VAL) {
+        frame |= (1<<n);
+    }
+    n++;
 #else
-        mask <<= 1;
+    (void)parity;
 #endif
+
+    /* stop bit */
+    frame |= (1<<n);
+    return frame;
+}
+
+void serial_send(uint8_t data)
+{
+    /* signal state: IDLE: ON, START: OFF, STOP: ON, DATA0: OFF, DATA1: ON */
+
+    // wait only when buffer is full, enqueue on full would count as dropped
+    while (!serial_send_space()) ;
+    tbuf_enqueue(data);
+
+    uint8_t sreg = SREG;
+    cli();
+    if (!tx_busy) {
+        tx_busy = true;
+        tx_bits = 0;
+        TIMER_OCRB = TIMER_TCNT + 16;
+        TIMER_TIFR = (1<<TIMER_OCFB);
+        TIMER_TIMSK |= (1<<TIMER_OCIEB);
     }
+    SREG = sreg;
+}
+
+uint8_t serial_send_space(void)
+{
+    return (SERIAL_SOFT_TX_BUFFER_SIZE - 1) - tbuf_count();
+}
 
+/* TX: puts next bit at bit boundary */
+ISR(TIMER_COMPB_VECT)
+{
+    if (tx_bits == 0) {
+        // end of stop bit
+        if (!tbuf_has_data()) {
+            TIMER_TIMSK &= ~(1<<TIMER_OCIEB);
+            tx_busy = false;
+            return;
+        }
+        tx_frame = tx_frame_of(tbuf_dequeue());
 #if defined(SERIAL_SOFT_PARITY_EVEN) || defined(SERIAL_SOFT_PARITY_ODD)
-    /* to center of parity bit */
-    if (parity != SERIAL_SOFT_PARITY_VAL) {
+        tx_bits = 1 + DATA_BITS + 1 + 1;
+#else
+        tx_bits = 1 + DATA_BITS + 1;
+#endif
+    }
+
+    if (tx_frame & 1) {
         SERIAL_SOFT_TXD_ON();
     } else {
         SERIAL_SOFT_TXD_OFF();
     }
-    _delay_us(WAIT_US);
-#endif
-
-    /* stop bit */
-    SERIAL_SOFT_TXD_ON();
-    _delay_us(WAIT_US);
+    tx_frame >>= 1;
+    tx_bits--;
+    TIMER_OCRB += BIT_TICKS;
 }
 
 /* detect edge of start bit */
 ISR(SERIAL_SOFT_RXD_VECT)
 {
+    // edges of data bits while receiving frame
+    if (rx_busy) return;
+
     SERIAL_SOFT_DEBUG_TGL();
     SERIAL_SOFT_RXD_INT_ENTER();
 
-    uint8_t data = 0;
+    rx_busy = true;
+    rx_bit = 0;
+    rx_data = 0;
+    rx_parity = 0;
 
-#ifdef SERIAL_SOFT_BIT_ORDER_MSB
-    #ifdef SERIAL_SOFT_DATA_7BIT
-    uint8_t mask = 0x40;
-    #else
-    uint8_t mask = 0x80;
-    #endif
-#else
-    uint8_t mask = 0x01;
-#endif
-
-    uint8_t parity = 0;
+    /* to center of first data bit */
+    TIMER_OCRA = TIMER_TCNT + BIT_TICKS + BIT_TICKS/2;
+    TIMER_TIFR = (1<<TIMER_OCFA);
+    TIMER_TIMSK |= (1<<TIMER_OCIEA);
+}
 
-    /* to center of start bit */
-    _delay_us(WAIT_US/2);
+/* RX: samples at center of each bit */
+ISR(TIMER_COMPA_VECT)
+{
     SERIAL_SOFT_DEBUG_TGL();
-    do {
-        /* to center of next bit */
-        _delay_us(WAIT_US);
+    TIMER_OCRA += BIT_TICKS;
 
-    SERIAL_SOFT_DEBUG_TGL();
-        if (SERIAL_SOFT_RXD_IN()) {
-            data |= mask;
-            parity ^= 1;
-        }
+    bool in = SERIAL_SOFT_RXD_IN();
+    if (rx_bit < DATA_BITS) {
+        if (in) {
 #ifdef SERIAL_SOFT_BIT_ORDER_MSB
-        mask >>= 1;
+            rx_data |= (1<<(DATA_BITS - 1 - rx_bit));
 #else
-        mask <<= 1;
-#endif
-#ifdef SERIAL_SOFT_DATA_7BIT
-    } while (mask&0x7F);
-#else
-    } while (mask&0xFF);
+            rx_data |= (1<<rx_bit);
 #endif
+            rx_parity ^= 1;
+        }
+        rx_bit++;
+        return;
+    }
 
 #if defined(SERIAL_SOFT_PARITY_EVEN) || defined(SERIAL_SOFT_PARITY_ODD)
-    /* to center of parity bit */
-    _delay_us(WAIT_US);
-    if (SERIAL_SOFT_RXD_IN()) { parity ^= 1; }
-    SERIAL_SOFT_DEBUG_TGL();
-#endif
-
-    /* to center of stop bit */
-    _delay_us(WAIT_US);
+    if (rx_bit == DATA_BITS) {
+        /* parity bit */
+        if (in) { rx_parity ^= 1; }
+        rx_bit++;
+        return;
+    }
 
-    uint8_t next = (rbuf_head + 1) % RBUF_SIZE;
-#if defined(SERIAL_SOFT_PARITY_EVEN) || defined(SERIAL_SOFT_PARITY_ODD)
-    if ((parity == SERIAL_SOFT_PARITY_VAL) && next != rbuf_tail) {
+    /* center of stop bit */
+    if (rx_parity == SERIAL_SOFT_PARITY_VAL) {
+        rbuf_enqueue(rx_data);
+    }
 #else
-    if (next != rbuf_tail) {
+    /* center of stop bit */
+    rbuf_enqueue(rx_data);
 #endif
-        rbuf[rbuf_head] = data;
-        rbuf_head = next;
-    }
 
+    TIMER_TIMSK &= ~(1<<TIMER_OCIEA);
+    rx_busy = false;
     SERIAL_SOFT_RXD_INT_EXIT();
-    SERIAL_SOFT_DEBUG_TGL();
+}
+
+void serial_print_stats(void)
+{
+    ring_buffer_stats_t r = rbuf_stats();
+    ring_buffer_stats_t t = tbuf_stats();
+    xprintf("serial rx: dropped:%u high:%u/%u tx: high:%u/%u\n",
+            r.dropped, r.high, r.size, t.high, t.size);
 }
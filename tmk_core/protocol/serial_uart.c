@@ -39,6 +39,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "serial.h"
+#include "ring_buffer.h"
+#include "print.h"
 
 
 #if defined(SERIAL_UART_RTS_LO) && defined(SERIAL_UART_RTS_HI)
@@ -46,7 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
     //   Empty:           RBUF_SPACE == RBUF_SIZE(head==tail)
     //   Last 1 space:    RBUF_SPACE == 2
     //   Full:            RBUF_SPACE == 1(last cell of rbuf be never used.)
-    #define RBUF_SPACE()   (rbuf_head < rbuf_tail ?  (rbuf_tail - rbuf_head) : (RBUF_SIZE - rbuf_head + rbuf_tail))
+    #define RBUF_SPACE()   (RBUF_SIZE - rbuf_count())
     // allow to send
     #define rbuf_check_rts_lo() do { if (RBUF_SPACE() > 2) SERIAL_UART_RTS_LO(); } while (0)
     // prohibit to send
@@ -64,49 +66,87 @@ void serial_init(void)
 
 // RX ring buffer
 #define RBUF_SIZE   256
-static uint8_t rbuf[RBUF_SIZE];
-static uint8_t rbuf_head = 0;
-static uint8_t rbuf_tail = 0;
+RING_BUFFER(rbuf, uint8_t, RBUF_SIZE)
 
 uint8_t serial_recv(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
+    if (!rbuf_has_data()) {
         return 0;
     }
 
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
+    uint8_t data = rbuf_dequeue();
     rbuf_check_rts_lo();
     return data;
 }
 
 int16_t serial_recv2(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
+    if (!rbuf_has_data()) {
         return -1;
     }
 
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
+    uint8_t data = rbuf_dequeue();
     rbuf_check_rts_lo();
     return data;
 }
 
+#ifdef SERIAL_UART_TXD_VECT
+// TX ring buffer: drained by data register empty interrupt
+#ifndef SERIAL_UART_TBUF_SIZE
+#define SERIAL_UART_TBUF_SIZE   64
+#endif
+RING_BUFFER(tbuf, uint8_t, SERIAL_UART_TBUF_SIZE)
+
+void serial_send(uint8_t data)
+{
+    // wait only when buffer is full, enqueue on full would count as dropped
+    while (!serial_send_space()) ;
+    tbuf_enqueue(data);
+    SERIAL_UART_TXD_INT_ON();
+}
+
+uint8_t serial_send_space(void)
+{
+    return (SERIAL_UART_TBUF_SIZE - 1) - tbuf_count();
+}
+
+// USART data register empty interrupt
+ISR(SERIAL_UART_TXD_VECT)
+{
+    if (tbuf_has_data()) {
+        SERIAL_UART_DATA = tbuf_dequeue();
+    } else {
+        SERIAL_UART_TXD_INT_OFF();
+    }
+}
+#else
 void serial_send(uint8_t data)
 {
     while (!SERIAL_UART_TXD_READY) ;
     SERIAL_UART_DATA = data;
 }
 
+/* serial_send() waits for data register, any length can be sent */
+uint8_t serial_send_space(void)
+{
+    return UINT8_MAX;
+}
+#endif
+
 // USART RX complete interrupt
 ISR(SERIAL_UART_RXD_VECT)
 {
-    uint8_t next = (rbuf_head + 1) % RBUF_SIZE;
-    if (next != rbuf_tail) {
-        rbuf[rbuf_head] = SERIAL_UART_DATA;
-        rbuf_head = next;
-    }
+    rbuf_enqueue(SERIAL_UART_DATA);
     rbuf_check_rts_hi();
 }
+
+void serial_print_stats(void)
+{
+    ring_buffer_stats_t r = rbuf_stats();
+    xprintf("serial rx: dropped:%u high:%u/%u", r.dropped, r.high, r.size);
+#ifdef SERIAL_UART_TXD_VECT
+    ring_buffer_stats_t t = tbuf_stats();
+    xprintf(" tx: high:%u/%u", t.high, t.size);
+#endif
+    xprintf("\n");
+}
@@ -0,0 +1,215 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <util/twi.h>
+#include "timer.h"
+#include "twi.h"
+
+
+/* Bit rate with no prescaler: SCL = F_CPU / (16 + 2 * TWBR) */
+#ifndef TWI_TWBR
+#define TWI_TWBR        ((F_CPU / TWI_FREQ - 16) / 2)
+#endif
+
+/* Pins for bus recovery */
+#ifndef TWI_PORT
+#   if defined(__AVR_ATmega32U4__) || defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB646__)
+#       define TWI_PORT     PORTD
+#       define TWI_PIN      PIND
+#       define TWI_DDR      DDRD
+#       define TWI_SCL_BIT  0
+#       define TWI_SDA_BIT  1
+#   elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega88__)
+#       define TWI_PORT     PORTC
+#       define TWI_PIN      PINC
+#       define TWI_DDR      DDRC
+#       define TWI_SCL_BIT  5
+#       define TWI_SDA_BIT  4
+#   else
+#       error "TWI: define TWI_PORT, TWI_PIN, TWI_DDR, TWI_SCL_BIT and TWI_SDA_BIT"
+#   endif
+#endif
+
+#define TWCR_NEXT   ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+#define TWCR_STOP   ((1<<TWINT) | (1<<TWEN) | (1<<TWSTO))
+
+
+static const twi_msg_t *msg;
+static uint8_t msg_left;
+static uint8_t pos;
+static volatile uint8_t status = TWI_OK;
+static uint16_t started;
+
+
+void twi_init(void)
+{
+    TWSR = 0;
+    TWBR = TWI_TWBR;
+    TWCR = (1<<TWEN);
+    status = TWI_OK;
+}
+
+/* Starts transfer and returns at once, false if previous one is running */
+bool twi_start(const twi_msg_t *msgs, uint8_t count)
+{
+    if (status == TWI_BUSY || count == 0) return false;
+
+    // STOP of last transfer may be still going out
+    uint8_t wait = 255;
+    while (TWCR & (1<<TWSTO)) {
+        if (--wait == 0) {
+            twi_recover();
+            break;
+        }
+        _delay_us(1);
+    }
+
+    msg = msgs;
+    msg_left = count;
+    pos = 0;
+    started = timer_read();
+    status = TWI_BUSY;
+    TWCR = TWCR_NEXT | (1<<TWSTA);
+    return true;
+}
+
+/* Returns TWI_BUSY while transfer is running, aborts it on timeout */
+uint8_t twi_status(void)
+{
+    if (status == TWI_BUSY && timer_elapsed(started) > TWI_TIMEOUT) {
+        twi_recover();
+        status = TWI_ERR_TIMEOUT;
+    }
+    return status;
+}
+
+uint8_t twi_wait(void)
+{
+    uint8_t s;
+    while ((s = twi_status()) == TWI_BUSY) ;
+    return s;
+}
+
+/* Blocking transfer */
+uint8_t twi_transfer(const twi_msg_t *msgs, uint8_t count)
+{
+    if (!twi_start(msgs, count)) return TWI_BUSY;
+    return twi_wait();
+}
+
+/* Frees bus held by slave which lost its clock in the middle of byte.
+ * SCL is pulsed up to nine times until SDA goes high, then STOP is sent
+ * and TWI is started again.
+ */
+void twi_recover(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    TWCR = 0;
+    SREG = sreg;
+
+    // open drain: output low or input Hi-Z
+    TWI_DDR  &= ~(1<<TWI_SCL_BIT | 1<<TWI_SDA_BIT);
+    TWI_PORT &= ~(1<<TWI_SCL_BIT | 1<<TWI_SDA_BIT);
+    _delay_us(5);
+    for (uint8_t i = 0; i < 9 && !(TWI_PIN & (1<<TWI_SDA_BIT)); i++) {
+        TWI_DDR |=  (1<<TWI_SCL_BIT);
+        _delay_us(5);
+        TWI_DDR &= ~(1<<TWI_SCL_BIT);
+        _delay_us(5);
+    }
+    // STOP: SDA rises while SCL is high
+    TWI_DDR |=  (1<<TWI_SDA_BIT);
+    _delay_us(5);
+    TWI_DDR &= ~(1<<TWI_SDA_BIT);
+    _delay_us(5);
+
+    twi_init();
+}
+
+static void next_msg(void)
+{
+    if (--msg_left) {
+        msg++;
+        pos = 0;
+        TWCR = TWCR_NEXT | (1<<TWSTA);  // repeated START
+    } else {
+        TWCR = TWCR_STOP;
+        status = TWI_OK;
+    }
+}
+
+ISR(TWI_vect)
+{
+    switch (TW_STATUS) {
+        case TW_START:
+        case TW_REP_START:
+            TWDR = (msg->addr<<1) | msg->dir;
+            TWCR = TWCR_NEXT;
+            break;
+
+        case TW_MT_SLA_ACK:
+        case TW_MT_DATA_ACK:
+            if (pos < msg->len) {
+                TWDR = msg->buf[pos++];
+                TWCR = TWCR_NEXT;
+            } else {
+                next_msg();
+            }
+            break;
+
+        case TW_MR_DATA_ACK:
+            msg->buf[pos++] = TWDR;
+            // fall through
+        case TW_MR_SLA_ACK:
+            // ACK all but last byte
+            if (pos + 1 < msg->len) {
+                TWCR = TWCR_NEXT | (1<<TWEA);
+            } else {
+                TWCR = TWCR_NEXT;
+            }
+            break;
+
+        case TW_MR_DATA_NACK:
+            msg->buf[pos++] = TWDR;
+            next_msg();
+            break;
+
+        case TW_MT_SLA_NACK:
+        case TW_MR_SLA_NACK:
+        case TW_MT_DATA_NACK:
+            TWCR = TWCR_STOP;
+            status = TWI_ERR_NACK;
+            break;
+
+        case TW_MT_ARB_LOST:
+            // released, no STOP
+            TWCR = (1<<TWINT) | (1<<TWEN);
+            status = TWI_ERR_BUS;
+            break;
+
+        default:
+            // TW_BUS_ERROR: STOP resets TWI without going on the bus
+            TWCR = TWCR_STOP;
+            status = TWI_ERR_BUS;
+            break;
+    }
+}
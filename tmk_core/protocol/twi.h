@@ -0,0 +1,80 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TWI_H
+#define TWI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*
+ * Interrupt driven TWI(I2C) master
+ *
+ * A transfer is a list of messages. Each message starts with START or
+ * repeated START and the last one ends with STOP. twi_start() returns at
+ * once and the transfer runs in TWI interrupt, caller can do other work
+ * meanwhile and poll twi_status() for completion.
+ *
+ *   uint8_t reg = GPIOB, cols;
+ *   twi_msg_t msgs[] = {
+ *       { ADDR, TWI_WRITE, 1, &reg },
+ *       { ADDR, TWI_READ,  1, &cols },
+ *   };
+ *   twi_start(msgs, 2);
+ *   // scan local rows here
+ *   if (twi_wait() != TWI_OK) ...
+ *
+ * Messages and their buffers must stay valid until the transfer is done.
+ * Read message needs at least one byte. Interrupts must be enabled.
+ *
+ * Transfer not finished in TWI_TIMEOUT ms is aborted and the bus is
+ * recovered by clocking SCL until slave releases SDA, so that unplugged
+ * or wedged slave doesn't lock up the main loop.
+ */
+#ifndef TWI_FREQ
+#define TWI_FREQ        400000
+#endif
+#ifndef TWI_TIMEOUT
+#define TWI_TIMEOUT     5       // ms
+#endif
+
+#define TWI_WRITE       0
+#define TWI_READ        1
+
+typedef struct {
+    uint8_t addr;       // 7-bit slave address
+    uint8_t dir;        // TWI_WRITE or TWI_READ
+    uint8_t len;
+    uint8_t *buf;
+} twi_msg_t;
+
+enum twi_status {
+    TWI_OK = 0,
+    TWI_BUSY,
+    TWI_ERR_NACK,       // no slave at the address or data refused
+    TWI_ERR_BUS,        // arbitration lost or bus error
+    TWI_ERR_TIMEOUT,
+};
+
+void twi_init(void);
+bool twi_start(const twi_msg_t *msgs, uint8_t count);
+uint8_t twi_status(void);
+uint8_t twi_wait(void);
+uint8_t twi_transfer(const twi_msg_t *msgs, uint8_t count);
+void twi_recover(void);
+
+#endif
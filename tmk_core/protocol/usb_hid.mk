@@ -37,6 +37,15 @@ ARDUINO_CORES_SRC = \
 # HID parser
 #
 SRC += $(USB_HID_DIR)/parser.cpp
+SRC += $(USB_HID_DIR)/kbdpoll.cpp
+
+# Report protocol keyboard with compiled report descriptor
+ifdef USB_HID_REPORT_PROTOCOL
+    SRC += $(USB_HOST_SHIELD_DIR)/hiduniversal.cpp
+    SRC += $(USB_HID_DIR)/kbd_plan.cpp
+    SRC += $(USB_HID_DIR)/hidreport.cpp
+    OPT_DEFS += -DUSB_HID_REPORT_PROTOCOL
+endif
 
 # replace arduino/CDC.cpp
 SRC += $(USB_HID_DIR)/override_Serial.cpp
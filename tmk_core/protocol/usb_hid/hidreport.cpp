@@ -0,0 +1,226 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "hidreport.h"
+#include "usb_hid.h"
+#include "kbdpoll.h"
+
+#include "debug.h"
+
+
+#define REPORT_DESC_MAX 512
+
+HIDReportKeyboard::HIDReportKeyboard(USB *p, uint8_t index) :
+    HIDUniversal(p), nplans(0), index(index), interval(0)
+#ifdef USB_HOST_INT
+    , xfer_iface(0)
+#endif
+{
+}
+
+void HIDReportKeyboard::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t proto, const USB_ENDPOINT_DESCRIPTOR *ep)
+{
+    HIDUniversal::EndpointXtract(conf, iface, alt, proto, ep);
+
+    // HIDUniversal keeps its poll interval private
+    if (interval < ep->bInterval) {
+        interval = ep->bInterval;
+    }
+}
+
+/* Called at end of HIDUniversal::Init() */
+uint8_t HIDReportKeyboard::OnInitSuccessful()
+{
+    nplans = 0;
+    for (uint8_t i = 0; i < maxHidInterfaces; i++) {
+        if (hidInterfaces[i].epIndex[epInterruptInIndex] == 0) continue;
+
+        // devices may start in boot protocol if they were used by BIOS
+        SetProtocol(hidInterfaces[i].bmInterface, HID_RPT_PROTOCOL);
+
+        // HID::GetReportDescr() reads only first 128 bytes of descriptor
+        uint8_t buf[64];
+        KBDPlanCompiler compiler(&plans[nplans], KBD_PLAN_MAX - nplans, i);
+        uint8_t rcode = pUsb->ctrlReq(bAddress, 0x00, bmREQ_HID_REPORT, USB_REQUEST_GET_DESCRIPTOR,
+                0x00, HID_DESCRIPTOR_REPORT, hidInterfaces[i].bmInterface,
+                REPORT_DESC_MAX, sizeof(buf), buf, &compiler);
+        if (rcode) {
+            dprintf("report descriptor: iface:%u error:%02X\n", hidInterfaces[i].bmInterface, rcode);
+            continue;
+        }
+        nplans += compiler.Finish();
+        if (compiler.HasReportId()) bHasReportId = true;
+    }
+
+    for (uint8_t p = 0; p < nplans; p++) {
+        dprintf("keyboard%u plan%u: iface:%u id:%u len:%u\n", index, p, plans[p].iface, plans[p].report_id, plans[p].length);
+        for (uint8_t f = 0; f < plans[p].nfields; f++) {
+            kbd_field_t *field = &plans[p].field[f];
+            dprintf("  %s offset:%u size:%u count:%u usage:%02X\n",
+                    (field->type == KBD_FIELD_BITMAP ? "bitmap" : "array "),
+                    field->offset, field->size, field->count, field->usage_min);
+        }
+    }
+    return 0;
+}
+
+uint8_t HIDReportKeyboard::Release()
+{
+    nplans = 0;
+    interval = 0;
+    kbd_poll_release(index);
+#ifdef USB_HOST_INT
+    if (kbd_xfer_owner == index) kbd_xfer_end();
+#endif
+    return HIDUniversal::Release();
+}
+
+/* HIDUniversal::Poll() gives up on first NAKing interface and passes no
+ * interface index to parser, so NKRO interface behind boot interface is
+ * never read. All interrupt IN endpoints are read here instead.
+ */
+uint8_t HIDReportKeyboard::Poll()
+{
+#ifdef USB_HOST_INT
+    // other keyboard launched its transfer earlier in this USB::Task() pass
+    if (kbd_xfer_owner != KBD_XFER_NONE) return 0;
+#endif
+    if (!isReady() || !kbd_poll_due(index)) return 0;
+    kbd_poll_done(index, interval);
+
+#ifdef USB_HOST_INT
+    XferStart(0);
+#else
+    for (uint8_t i = 0; i < maxHidInterfaces; i++) {
+        uint8_t ep = hidInterfaces[i].epIndex[epInterruptInIndex];
+        if (ep == 0) continue;
+
+        uint8_t buf[64];
+        uint16_t read = epInfo[ep].maxPktSize;
+        if (read > sizeof(buf)) read = sizeof(buf);
+
+        uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[ep].epAddr, &read, buf);
+        if (rcode) {
+            if (rcode != hrNAK) {
+                dprintf("HIDReportKeyboard: Poll: %02X\n", rcode);
+            }
+            continue;
+        }
+        ParseReport(i, read, buf);
+    }
+#endif
+    return 0;
+}
+
+#ifdef USB_HOST_INT
+/* Launches IN token to interrupt endpoint of next interface from 'from'
+ * and returns without waiting, the bus is released when none is left.
+ */
+void HIDReportKeyboard::XferStart(uint8_t from)
+{
+    for (uint8_t i = from; i < maxHidInterfaces; i++) {
+        uint8_t ep = hidInterfaces[i].epIndex[epInterruptInIndex];
+        if (ep == 0) continue;
+
+        // USB::SetAddress() is private, peripheral address and speed are set
+        // here the same way. Low speed device behind hub needs preamble.
+        UsbDevice *p = pUsb->GetAddressPool().GetUsbDevicePtr(bAddress);
+        if (!p) break;
+        pUsb->regWr(rPERADDR, bAddress);
+        uint8_t mode = pUsb->regRd(rMODE);
+        if (p->lowspeed) {
+            mode |= bmLOWSPEED | (p->address.bmParent ? bmHUBPRE : 0);
+        } else {
+            mode &= ~(bmHUBPRE | bmLOWSPEED);
+        }
+        pUsb->regWr(rMODE, mode);
+        pUsb->regWr(rHCTL, epInfo[ep].bmRcvToggle ? bmRCVTOG1 : bmRCVTOG0);
+        pUsb->regWr(rHXFR, tokIN | epInfo[ep].epAddr);
+
+        xfer_iface = i;
+        kbd_xfer_begin(index);
+        return;
+    }
+    kbd_xfer_end();
+}
+
+/* Called when MAX3421E INT is asserted while this keyboard owns the bus.
+ * Reads result of IN transfer on HXFRDN and data on RCVDAV, then launches
+ * next interface. NAK is not retried, endpoint is polled again in next
+ * interval.
+ */
+void HIDReportKeyboard::XferTask()
+{
+    uint8_t hirq = pUsb->regRd(rHIRQ);
+    if (!(hirq & bmHXFRDNIRQ)) {
+        if (kbd_xfer_expired()) {
+            dprintf("HIDReportKeyboard: Xfer: timeout\n");
+            kbd_xfer_end();
+        }
+        return;
+    }
+    pUsb->regWr(rHIRQ, bmHXFRDNIRQ);
+
+    uint8_t i = xfer_iface;
+    uint8_t ep = hidInterfaces[i].epIndex[epInterruptInIndex];
+    uint8_t hrsl = pUsb->regRd(rHRSL);
+    switch (hrsl & 0x0F) {
+        case hrSUCCESS:
+            if (hirq & bmRCVDAVIRQ) {
+                uint8_t buf[64];
+                uint8_t len = pUsb->regRd(rRCVBC);
+                if (len > epInfo[ep].maxPktSize) len = epInfo[ep].maxPktSize;
+                if (len > sizeof(buf)) len = sizeof(buf);
+                pUsb->bytesRd(rRCVFIFO, len, buf);
+                pUsb->regWr(rHIRQ, bmRCVDAVIRQ);
+                epInfo[ep].bmRcvToggle = (hrsl & bmRCVTOGRD) ? 1 : 0;
+                ParseReport(i, len, buf);
+            }
+            break;
+        case hrNAK:
+            break;
+        case hrTOGERR:
+            // same as USB::InTransfer(), toggle is right on next poll
+            epInfo[ep].bmRcvToggle = (hrsl & bmRCVTOGRD) ? 0 : 1;
+            break;
+        default:
+            dprintf("HIDReportKeyboard: Xfer: %02X\n", hrsl & 0x0F);
+            break;
+    }
+    XferStart(i + 1);
+}
+#endif
+
+void HIDReportKeyboard::ParseReport(uint8_t iface, uint8_t len, uint8_t *buf)
+{
+    bool changed = false;
+    for (uint8_t p = 0; p < nplans; p++) {
+        if (kbd_plan_match(&plans[p], iface, len, buf)) {
+            changed |= kbd_plan_decode(&plans[p], len, buf);
+        }
+    }
+    if (!changed) return;
+
+    // boot and NKRO reports of one keyboard may be both active
+    for (uint8_t i = 0; i < KBD_BITS_SIZE; i++) {
+        uint8_t bits = 0;
+        for (uint8_t p = 0; p < nplans; p++) {
+            bits |= plans[p].bits[i];
+        }
+        usb_hid_keyboard_bits[index][i] = bits;
+    }
+    usb_hid_time_stamp = millis();
+}
@@ -0,0 +1,59 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HIDREPORT_H
+#define HIDREPORT_H
+
+#include "hiduniversal.h"
+#include "kbd_plan.h"
+
+
+/* Report protocol keyboard
+ *
+ * Report descriptors of all HID interfaces are compiled into decode plans
+ * at enumeration, so that NKRO keyboards which place key bitmap on
+ * non-boot interface or in report with ID keep full rollover.
+ */
+class HIDReportKeyboard : public HIDUniversal {
+public:
+    HIDReportKeyboard(USB *p, uint8_t index = 0);
+
+    uint8_t Poll();
+    uint8_t Release();
+    void EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t proto, const USB_ENDPOINT_DESCRIPTOR *ep);
+#ifdef USB_HOST_INT
+    void XferTask();
+#endif
+
+protected:
+    uint8_t OnInitSuccessful();
+
+private:
+    void ParseReport(uint8_t iface, uint8_t len, uint8_t *buf);
+#ifdef USB_HOST_INT
+    void XferStart(uint8_t from);
+#endif
+
+    kbd_plan_t plans[KBD_PLAN_MAX];
+    uint8_t nplans;
+    uint8_t index;          // source keyboard
+    uint8_t interval;
+#ifdef USB_HOST_INT
+    uint8_t xfer_iface;     // interface of IN transfer on the bus
+#endif
+};
+
+#endif
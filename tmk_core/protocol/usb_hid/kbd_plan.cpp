@@ -0,0 +1,302 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "hid.h"
+#include "kbd_plan.h"
+#include "keycode.h"
+
+
+#define USAGE_PAGE_KEYBOARD 0x07
+
+/* item parser state */
+enum {
+    ITEM_PREFIX = 0,
+    ITEM_DATA,
+    ITEM_LONG_SIZE,
+    ITEM_LONG_TAG,
+    ITEM_LONG_DATA,
+};
+
+
+KBDPlanCompiler::KBDPlanCompiler(kbd_plan_t *plans, uint8_t max, uint8_t iface) :
+    plans(plans), max(max), nplans(0), iface(iface),
+    prefix(0), remain(0), size(0), data(0), state(ITEM_PREFIX),
+    usage_page(0), logical_min(0), logical_max(0),
+    report_size(0), report_id(0), report_count(0), has_report_id(false),
+    usage(0), usage_min(0), usage_max(0), has_usage(false),
+    nids(0)
+{
+}
+
+void KBDPlanCompiler::Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        uint8_t c = pbuf[i];
+
+        switch (state) {
+            case ITEM_PREFIX:
+                if (c == HID_LONG_ITEM_PREFIX) {
+                    state = ITEM_LONG_SIZE;
+                    break;
+                }
+                prefix = c;
+                size = ((c & DATA_SIZE_MASK) == DATA_SIZE_4) ? 4 : (c & DATA_SIZE_MASK);
+                remain = size;
+                data = 0;
+                if (remain) {
+                    state = ITEM_DATA;
+                } else {
+                    Item();
+                }
+                break;
+            case ITEM_DATA:
+                data |= (uint32_t)c << (8 * (size - remain));
+                if (--remain == 0) {
+                    Item();
+                    state = ITEM_PREFIX;
+                }
+                break;
+            case ITEM_LONG_SIZE:
+                remain = c;
+                state = ITEM_LONG_TAG;
+                break;
+            case ITEM_LONG_TAG:
+                state = remain ? ITEM_LONG_DATA : ITEM_PREFIX;
+                break;
+            case ITEM_LONG_DATA:
+                if (--remain == 0) {
+                    state = ITEM_PREFIX;
+                }
+                break;
+        }
+    }
+}
+
+void KBDPlanCompiler::Item(void)
+{
+    int32_t sdata = data;
+
+    // sign extension for logical min/max
+    if (size == 1) sdata = (int8_t)data;
+    if (size == 2) sdata = (int16_t)data;
+
+    switch (prefix & (TYPE_MASK | TAG_MASK)) {
+        case (TYPE_GLOBAL | TAG_GLOBAL_USAGEPAGE):
+            usage_page = data;
+            break;
+        case (TYPE_GLOBAL | TAG_GLOBAL_LOGICALMIN):
+            logical_min = sdata;
+            break;
+        case (TYPE_GLOBAL | TAG_GLOBAL_LOGICALMAX):
+            // some keyboards declare 0xFF as one byte 'Logical Maximum (-1)'
+            logical_max = (sdata < logical_min) ? (int32_t)data : sdata;
+            break;
+        case (TYPE_GLOBAL | TAG_GLOBAL_REPORTSIZE):
+            report_size = data;
+            break;
+        case (TYPE_GLOBAL | TAG_GLOBAL_REPORTID):
+            report_id = data;
+            has_report_id = true;
+            break;
+        case (TYPE_GLOBAL | TAG_GLOBAL_REPORTCOUNT):
+            report_count = data;
+            break;
+        case (TYPE_LOCAL | TAG_LOCAL_USAGE):
+            // only first usage of list is used; keyboards list contiguous usages
+            if (!has_usage) {
+                usage = data;
+                has_usage = true;
+            }
+            break;
+        case (TYPE_LOCAL | TAG_LOCAL_USAGEMIN):
+            usage_min = data;
+            break;
+        case (TYPE_LOCAL | TAG_LOCAL_USAGEMAX):
+            usage_max = data;
+            break;
+        case (TYPE_MAIN | TAG_MAIN_INPUT):
+            Input();
+            // fall through
+        case (TYPE_MAIN | TAG_MAIN_OUTPUT):
+        case (TYPE_MAIN | TAG_MAIN_FEATURE):
+        case (TYPE_MAIN | TAG_MAIN_COLLECTION):
+        case (TYPE_MAIN | TAG_MAIN_ENDCOLLECTION):
+            // local items are reset by main item
+            usage = usage_min = usage_max = 0;
+            has_usage = false;
+            break;
+        default:
+            // Push/Pop, physical and unit items are not needed
+            break;
+    }
+}
+
+void KBDPlanCompiler::Input(void)
+{
+    uint8_t n;
+    for (n = 0; n < nids; n++) {
+        if (input[n].id == report_id) break;
+    }
+    if (n == nids) {
+        if (nids == KBD_PLAN_IDS) return;
+        input[nids].id = report_id;
+        input[nids].bits = 0;
+        nids++;
+    }
+
+    uint16_t offset = input[n].bits;
+    input[n].bits += (uint16_t)report_size * report_count;
+
+    // constant(padding) or other than keyboard
+    if (data & 0x01) return;
+    if (usage_page != USAGE_PAGE_KEYBOARD) return;
+    if (report_size == 0 || report_count == 0) return;
+
+    uint16_t first = (usage_min || usage_max) ? usage_min : usage;
+    if (first > 0xFF) return;
+
+    kbd_field_t field;
+    field.offset = offset;
+    field.count = report_count;
+    field.size = report_size;
+    field.usage_min = first;
+    field.logical_min = 0;
+    field.logical_max = 0;
+    if (data & 0x02) {
+        // bitmap: one bit per usage
+        if (report_size != 1) return;
+        field.type = KBD_FIELD_BITMAP;
+        if (first + field.count > 0x100) {
+            field.count = 0x100 - first;
+        }
+    } else {
+        // array: usage = value - logical_min + usage_min
+        if (report_size > 8) return;
+        if (logical_min < 0 || logical_min > 0xFF) return;
+        field.type = KBD_FIELD_ARRAY;
+        field.logical_min = logical_min;
+        field.logical_max = (logical_max > 0xFF) ? 0xFF : logical_max;
+    }
+
+    kbd_plan_t *plan = Plan();
+    if (!plan || plan->nfields == KBD_PLAN_FIELDS) return;
+    plan->field[plan->nfields++] = field;
+}
+
+kbd_plan_t *KBDPlanCompiler::Plan(void)
+{
+    for (uint8_t i = 0; i < nplans; i++) {
+        if (plans[i].report_id == report_id) return &plans[i];
+    }
+    if (nplans == max) return NULL;
+
+    kbd_plan_t *plan = &plans[nplans++];
+    memset(plan, 0, sizeof(kbd_plan_t));
+    plan->iface = iface;
+    plan->report_id = report_id;
+    return plan;
+}
+
+/* Returns number of plans compiled */
+uint8_t KBDPlanCompiler::Finish(void)
+{
+    for (uint8_t i = 0; i < nplans; i++) {
+        for (uint8_t n = 0; n < nids; n++) {
+            if (input[n].id == plans[i].report_id) {
+                plans[i].length = (input[n].bits + 7) / 8 + (plans[i].report_id ? 1 : 0);
+            }
+        }
+    }
+    return nplans;
+}
+
+
+bool kbd_plan_match(const kbd_plan_t *plan, uint8_t iface, uint8_t len, const uint8_t *buf)
+{
+    if (plan->iface != iface) return false;
+    if (plan->report_id) {
+        return (len && buf[0] == plan->report_id);
+    }
+    return true;
+}
+
+/* Decodes report into plan->bits
+ * Returns true when key state has changed. Reports with error usage
+ * (ErrorRollOver etc.) are ignored to keep last state.
+ */
+bool kbd_plan_decode(kbd_plan_t *plan, uint8_t len, const uint8_t *buf)
+{
+    uint8_t bits[KBD_BITS_SIZE];
+    memset(bits, 0, sizeof(bits));
+
+    if (plan->report_id) {
+        buf++; len--;
+    }
+
+    for (uint8_t f = 0; f < plan->nfields; f++) {
+        const kbd_field_t *field = &plan->field[f];
+
+        if (field->type == KBD_FIELD_BITMAP) {
+            uint16_t offset = field->offset;
+            uint16_t usage = field->usage_min;
+            uint16_t count = field->count;
+            while (count) {
+                uint8_t b = offset >> 3;
+                uint8_t s = offset & 7;
+                if (b >= len) break;
+
+                uint8_t v = buf[b] >> s;
+                if (s && b + 1 < len) v |= buf[b + 1] << (8 - s);
+                if (count < 8) {
+                    v &= (1 << count) - 1;
+                    count = 0;
+                } else {
+                    count -= 8;
+                }
+
+                bits[usage >> 3] |= v << (usage & 7);
+                if ((usage & 7) && (usage >> 3) + 1 < KBD_BITS_SIZE) {
+                    bits[(usage >> 3) + 1] |= v >> (8 - (usage & 7));
+                }
+                offset += 8;
+                usage += 8;
+            }
+        } else {
+            uint8_t mask = (field->size == 8) ? 0xFF : (1 << field->size) - 1;
+            uint16_t offset = field->offset;
+            for (uint16_t i = 0; i < field->count; i++, offset += field->size) {
+                uint8_t b = offset >> 3;
+                uint8_t s = offset & 7;
+                if (b >= len) break;
+
+                uint8_t v = buf[b] >> s;
+                if (s && b + 1 < len) v |= buf[b + 1] << (8 - s);
+                v &= mask;
+
+                if (v < field->logical_min || v > field->logical_max) continue;
+                uint8_t code = v - field->logical_min + field->usage_min;
+                if (code == KC_NO) continue;
+                if (IS_ERROR(code)) return false;
+                bits[code >> 3] |= 1 << (code & 7);
+            }
+        }
+    }
+
+    if (memcmp(plan->bits, bits, sizeof(bits)) == 0) return false;
+    memcpy(plan->bits, bits, sizeof(bits));
+    return true;
+}
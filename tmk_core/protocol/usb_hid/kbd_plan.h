@@ -0,0 +1,128 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KBD_PLAN_H
+#define KBD_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Usb.h"
+
+
+/* Keyboard decode plan
+ *
+ * Report descriptor of a keyboard is compiled once at enumeration into
+ * a short list of fields on Keyboard/Keypad usage page(0x07). Incoming
+ * reports are decoded with the list into HID usage bitmap, no descriptor
+ * walk is needed per report.
+ *
+ * Bitmap field: Input(Data,Var) with Report Size 1, e.g. modifier byte
+ *               and NKRO key bitmap.
+ * Array field:  Input(Data,Array) with Report Size up to 8, e.g. 6KRO key
+ *               code slots.
+ */
+#ifndef KBD_PLAN_MAX
+#define KBD_PLAN_MAX        2   // keyboard reports per device
+#endif
+#ifndef KBD_PLAN_FIELDS
+#define KBD_PLAN_FIELDS     4   // keyboard fields per report
+#endif
+#define KBD_PLAN_IDS        8   // report IDs tracked while compiling
+
+/* HID usage bitmap: bit (code & 7) of byte (code >> 3) */
+#define KBD_BITS_SIZE       32
+
+enum kbd_field_type {
+    KBD_FIELD_BITMAP = 0,
+    KBD_FIELD_ARRAY,
+};
+
+typedef struct {
+    uint16_t offset;        // bit offset from start of report data(after report ID)
+    uint16_t count;         // Report Count
+    uint8_t  type;          // kbd_field_type
+    uint8_t  size;          // Report Size
+    uint8_t  usage_min;     // usage of first bit or of logical minimum
+    uint8_t  logical_min;   // array value range
+    uint8_t  logical_max;
+} kbd_field_t;
+
+typedef struct {
+    uint8_t iface;          // interface index
+    uint8_t report_id;      // 0: no report ID
+    uint8_t length;         // report length in bytes including report ID
+    uint8_t nfields;
+    kbd_field_t field[KBD_PLAN_FIELDS];
+    uint8_t bits[KBD_BITS_SIZE];    // last decoded state
+} kbd_plan_t;
+
+
+/* Report descriptor compiler
+ *
+ * Fed with descriptor stream by HID::GetReportDescr(), so that items can
+ * be split across packets.
+ */
+class KBDPlanCompiler : public USBReadParser {
+public:
+    KBDPlanCompiler(kbd_plan_t *plans, uint8_t max, uint8_t iface);
+    void Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset);
+    uint8_t Finish(void);
+    bool HasReportId(void) { return has_report_id; }
+
+private:
+    void Item(void);
+    void Input(void);
+    kbd_plan_t *Plan(void);
+
+    kbd_plan_t *plans;
+    uint8_t max;
+    uint8_t nplans;
+    uint8_t iface;
+
+    // item parser
+    uint8_t prefix;
+    uint8_t remain;
+    uint8_t size;
+    uint32_t data;
+    uint8_t state;
+
+    // global items
+    uint16_t usage_page;
+    int32_t logical_min;
+    int32_t logical_max;
+    uint8_t report_size;
+    uint8_t report_id;
+    uint16_t report_count;
+    bool has_report_id;
+
+    // local items
+    uint16_t usage;
+    uint16_t usage_min;
+    uint16_t usage_max;
+    bool has_usage;
+
+    // input bits per report ID
+    struct {
+        uint8_t id;
+        uint16_t bits;
+    } input[KBD_PLAN_IDS];
+    uint8_t nids;
+};
+
+bool kbd_plan_match(const kbd_plan_t *plan, uint8_t iface, uint8_t len, const uint8_t *buf);
+bool kbd_plan_decode(kbd_plan_t *plan, uint8_t len, const uint8_t *buf);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "Usb.h"
+#include "kbdpoll.h"
+#include "usb_hid.h"
+
+
+static struct {
+    uint32_t next;
+    bool active;
+} kbd_poll[USB_HID_KEYBOARD_COUNT];
+
+
+bool kbd_poll_due(uint8_t index)
+{
+    uint32_t now = millis();
+
+    if (!kbd_poll[index].active) {
+        kbd_poll[index].active = true;
+        kbd_poll[index].next = now;
+    }
+    if ((long)(now - kbd_poll[index].next) < 0L) return false;
+
+    // keyboard which has waited longest goes first
+    for (uint8_t i = 0; i < USB_HID_KEYBOARD_COUNT; i++) {
+        if (i == index || !kbd_poll[i].active) continue;
+        if ((long)(kbd_poll[i].next - kbd_poll[index].next) < 0L &&
+            (long)(now - kbd_poll[i].next) >= 0L) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void kbd_poll_done(uint8_t index, uint8_t interval)
+{
+    kbd_poll[index].next = millis() + interval;
+}
+
+/* Called when keyboard is detached: its keys are released */
+void kbd_poll_release(uint8_t index)
+{
+    kbd_poll[index].active = false;
+    memset(usb_hid_keyboard_bits[index], 0, USB_HID_KEYBOARD_BITS_SIZE);
+    usb_hid_time_stamp = millis();
+}
+
+/* Returns true when any keyboard is due to poll */
+bool kbd_poll_pending(void)
+{
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < USB_HID_KEYBOARD_COUNT; i++) {
+        if (kbd_poll[i].active && (long)(now - kbd_poll[i].next) >= 0L) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+uint8_t kbd_xfer_owner = KBD_XFER_NONE;
+static uint32_t kbd_xfer_time;
+
+void kbd_xfer_begin(uint8_t index)
+{
+    kbd_xfer_owner = index;
+    kbd_xfer_time = millis();
+}
+
+void kbd_xfer_end(void)
+{
+    kbd_xfer_owner = KBD_XFER_NONE;
+}
+
+/* Returns true when transfer has not completed in KBD_XFER_TIMEOUT */
+bool kbd_xfer_expired(void)
+{
+    return (long)(millis() - kbd_xfer_time) >= (long)KBD_XFER_TIMEOUT;
+}
@@ -0,0 +1,52 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KBDPOLL_H
+#define KBDPOLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* Poll scheduler for source keyboards
+ *
+ * USB::Task() calls Poll() of every device on each pass. A keyboard runs
+ * its IN transfer only when its bInterval has elapsed and no other keyboard
+ * has been waiting longer, so keyboards are served in turn by deadline.
+ */
+bool kbd_poll_due(uint8_t index);
+void kbd_poll_done(uint8_t index, uint8_t interval);
+void kbd_poll_release(uint8_t index);
+bool kbd_poll_pending(void);
+
+
+/* Split-phase IN transfer(USB_HOST_INT)
+ *
+ * A keyboard launches its IN token and returns, completion is picked up
+ * later by XferTask() on MAX3421E INT. Only one transfer can be on the
+ * bus, while kbd_xfer_owner is set neither USB::Task() nor control
+ * requests may run.
+ */
+#define KBD_XFER_NONE       0xFF
+#ifndef KBD_XFER_TIMEOUT
+#define KBD_XFER_TIMEOUT    10      // ms
+#endif
+extern uint8_t kbd_xfer_owner;
+void kbd_xfer_begin(uint8_t index);
+void kbd_xfer_end(void);
+bool kbd_xfer_expired(void);
+
+#endif
@@ -1,24 +1,34 @@
 #include "parser.h"
 #include "usb_hid.h"
+#include "keycode.h"
+#include "kbdpoll.h"
 
 #include "debug.h"
 
 
-report_keyboard_t usb_hid_keyboard_report;
+uint8_t usb_hid_keyboard_bits[USB_HID_KEYBOARD_COUNT][USB_HID_KEYBOARD_BITS_SIZE];
 uint16_t usb_hid_time_stamp;
 
 
+/* Boot keyboard report: modifiers, reserved and 6 keys
+ * KEYBOARD_REPORT_KEYS is not used here since it follows NKRO_ENABLE of
+ * device side.
+ */
+#define BOOT_REPORT_KEYS    6
+
 void KBDReportParser::Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf)
 {
     bool is_error = false;
-    report_keyboard_t *report = (report_keyboard_t *)buf;
+    uint8_t *keys = &buf[2];
+
+    if (len < 2 + BOOT_REPORT_KEYS) return;
 
-    dprintf("keyboard input:  %02X %02X", report->mods, report->reserved);
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        if (IS_ERROR(report->keys[i])) {
+    dprintf("keyboard%u input:  %02X %02X", index, buf[0], buf[1]);
+    for (uint8_t i = 0; i < BOOT_REPORT_KEYS; i++) {
+        if (IS_ERROR(keys[i])) {
             is_error = true;
         }
-        dprintf(" %02X", report->keys[i]);
+        dprintf(" %02X", keys[i]);
     }
     dprint("\r\n");
 
@@ -28,6 +38,48 @@ void KBDReportParser::Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf)
         return;
     }
 
-    ::memcpy(&usb_hid_keyboard_report, buf, sizeof(report_keyboard_t));
+    // modifiers are usage 0xE0-0xE7
+    uint8_t *bits = usb_hid_keyboard_bits[index];
+    ::memset(bits, 0, USB_HID_KEYBOARD_BITS_SIZE);
+    bits[KC_LCTRL >> 3] = buf[0];
+    for (uint8_t i = 0; i < BOOT_REPORT_KEYS; i++) {
+        if (IS_ANY(keys[i])) {
+            bits[keys[i] >> 3] |= 1 << (keys[i] & 7);
+        }
+    }
     usb_hid_time_stamp = millis();
 }
+
+
+HIDBootKeyboard::HIDBootKeyboard(USB *p, uint8_t index) :
+    HIDBoot<HID_PROTOCOL_KEYBOARD>(p), parser(index), index(index), interval(0)
+{
+    SetReportParser(0, &parser);
+}
+
+void HIDBootKeyboard::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t proto, const USB_ENDPOINT_DESCRIPTOR *ep)
+{
+    HIDBoot<HID_PROTOCOL_KEYBOARD>::EndpointXtract(conf, iface, alt, proto, ep);
+
+    // HIDBoot keeps its bInterval private
+    if (interval < ep->bInterval) {
+        interval = ep->bInterval;
+    }
+}
+
+uint8_t HIDBootKeyboard::Poll()
+{
+    if (!isReady() || !kbd_poll_due(index)) return 0;
+    uint8_t rcode = HIDBoot<HID_PROTOCOL_KEYBOARD>::Poll();
+    // HIDBoot has its own timer stamped after transfer with same interval,
+    // stamping after it as well keeps it due whenever this slot is due
+    kbd_poll_done(index, interval);
+    return rcode;
+}
+
+uint8_t HIDBootKeyboard::Release()
+{
+    interval = 0;
+    kbd_poll_release(index);
+    return HIDBoot<HID_PROTOCOL_KEYBOARD>::Release();
+}
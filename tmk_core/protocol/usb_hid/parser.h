@@ -2,11 +2,31 @@
 #define PARSER_H
 
 #include "hid.h"
+#include "hidboot.h"
 
 class KBDReportParser : public HIDReportParser
 {
 public:
+	KBDReportParser(uint8_t index = 0) : index(index) {};
 	virtual void Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf);
+
+private:
+	uint8_t index;	// source keyboard
+};
+
+/* Boot keyboard with its own parser, one instance per source keyboard */
+class HIDBootKeyboard : public HIDBoot<HID_PROTOCOL_KEYBOARD>
+{
+public:
+	HIDBootKeyboard(USB *p, uint8_t index = 0);
+	uint8_t Poll();
+	uint8_t Release();
+	void EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t proto, const USB_ENDPOINT_DESCRIPTOR *ep);
+
+private:
+	KBDReportParser parser;
+	uint8_t index;
+	uint8_t interval;
 };
 
 #endif
@@ -1,10 +1,24 @@
 #ifndef USB_HID_H
 #define USB_HID_H
 
-#include "report.h"
+#include <stdint.h>
 
 
-extern report_keyboard_t usb_hid_keyboard_report;
+/* Number of source keyboards, behind hub */
+#ifndef USB_HID_KEYBOARD_COUNT
+#define USB_HID_KEYBOARD_COUNT      1
+#endif
+
+/* Key state of each source keyboard as HID usage bitmap
+ * Usage code is bit (code & 7) of byte (code >> 3). Each keyboard owns
+ * its own bitmap, so that release on one keyboard doesn't cancel keys
+ * held on another.
+ */
+#define USB_HID_KEYBOARD_BITS_SIZE  32
+
+extern uint8_t usb_hid_keyboard_bits[USB_HID_KEYBOARD_COUNT][USB_HID_KEYBOARD_BITS_SIZE];
+
+/* updated when key state of any keyboard changes */
 extern uint16_t usb_hid_time_stamp;
 
 #endif
@@ -91,7 +91,9 @@ int main(void)
 
             // TODO: configuration process is incosistent. it sometime fails.
             // To prevent failing to configure NOT scan keyboard during configuration
-            if (usbConfiguration && usbInterruptIsReady()) {
+            // With MATRIX_SCAN_STEP a call scans only a slice of matrix.
+            // NKRO report on EP3 has to be sent before next event as well.
+            if (usbConfiguration && !vusb_keyboard_busy()) {
                 keyboard_task();
             }
             vusb_transfer_keyboard();
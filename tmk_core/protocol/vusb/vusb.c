@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <string.h>
 #include "usbdrv.h"
 #include "usbconfig.h"
 #include "host.h"
@@ -24,16 +25,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "host_driver.h"
 #include "vusb.h"
+#include "timer.h"
+#include "latency.h"
 
 
 static uint8_t vusb_keyboard_leds = 0;
-static uint8_t vusb_idle_rate = 0;
-
-/* Keyboard report send buffer */
-#define KBUF_SIZE 16
-static report_keyboard_t kbuf[KBUF_SIZE];
-static uint8_t kbuf_head = 0;
-static uint8_t kbuf_tail = 0;
+uint8_t keyboard_idle = 0;
+uint8_t keyboard_protocol = 1;
 
 typedef struct {
         uint8_t modifier;
@@ -43,12 +41,92 @@ typedef struct {
 
 static keyboard_report_t keyboard_report; // sent to PC
 
+/* Keyboard report send buffer */
+#define KBUF_SIZE 16
+static keyboard_report_t kbuf[KBUF_SIZE];
+static uint8_t kbuf_head = 0;
+static uint8_t kbuf_tail = 0;
+
+#ifdef NKRO_ENABLE
+/*
+ * NKRO on low-speed endpoint
+ *
+ * Packet of low-speed interrupt endpoint is 8 bytes at most. NKRO report
+ * is split into chunks with own report ID, each fits in a packet, and they
+ * are sent on interface 1(EP3) along with mouse and extra keys. Only chunks
+ * changed since last sent are transferred, one per interrupt poll.
+ *
+ * ID       |data                  |usage
+ * ---------+----------------------+-----------------
+ * NKRO     |mods, bits[0]-bits[5] |E0-E7, 00-2F
+ * NKRO+1   |bits[6]-bits[12]      |30-67
+ * NKRO+2   |bits[13]-bits[14]     |68-77
+ */
+#define REPORT_ID_NKRO  4
+#define NKRO_CHUNK      7
+#define NKRO_CHUNKS     ((KEYBOARD_REPORT_SIZE + NKRO_CHUNK - 1) / NKRO_CHUNK)
+
+static report_keyboard_t nkro_report;   // latest state
+static report_keyboard_t nkro_sent;     // state known to host
+static uint8_t nkro_dirty = 0;          // chunks to send
+
+static uint8_t nkro_chunk_len(uint8_t i)
+{
+    uint8_t rest = KEYBOARD_REPORT_SIZE - i * NKRO_CHUNK;
+    return (rest < NKRO_CHUNK) ? rest : NKRO_CHUNK;
+}
+
+static void nkro_transfer(void)
+{
+    if (!nkro_dirty || !usbInterruptIsReady3()) return;
+
+    uint8_t i = 0;
+    while (!(nkro_dirty & (1<<i))) i++;
+    uint8_t *data = &nkro_report.raw[i * NKRO_CHUNK];
+    uint8_t len = nkro_chunk_len(i);
+
+    uint8_t buf[1 + NKRO_CHUNK];
+    buf[0] = REPORT_ID_NKRO + i;
+    memcpy(&buf[1], data, len);
+    memcpy(&nkro_sent.raw[i * NKRO_CHUNK], data, len);
+    nkro_dirty &= ~(1<<i);
+    usbSetInterrupt3(buf, 1 + len);
+}
+
+/* Only latest state is kept, so previous one must reach host before it is
+ * overwritten, or press and release in a row(tap, macro) would be lost
+ * while EP3 is busy. Gives up after timeout when host doesn't poll. */
+#ifndef NKRO_FLUSH_TIMEOUT
+#define NKRO_FLUSH_TIMEOUT  (NKRO_CHUNKS * USB_CFG_INTR_POLL_INTERVAL * 4)  // ms
+#endif
+static void nkro_flush(void)
+{
+    uint16_t t = timer_read();
+    while (nkro_dirty && timer_elapsed(t) < NKRO_FLUSH_TIMEOUT) {
+        usbPoll();
+        nkro_transfer();
+    }
+}
+#endif
+
+/* true while keyboard report is waiting for endpoint */
+bool vusb_keyboard_busy(void)
+{
+#ifdef NKRO_ENABLE
+    if (nkro_dirty) return true;
+#endif
+    return !usbInterruptIsReady();
+}
+
 /* transfer keyboard report from buffer */
 void vusb_transfer_keyboard(void)
 {
+#ifdef NKRO_ENABLE
+    nkro_transfer();
+#endif
     if (usbInterruptIsReady()) {
         if (kbuf_head != kbuf_tail) {
-            usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(report_keyboard_t));
+            usbSetInterrupt((void *)&kbuf[kbuf_tail], sizeof(keyboard_report_t));
             kbuf_tail = (kbuf_tail + 1) % KBUF_SIZE;
             if (debug_keyboard) {
                 print("V-USB: kbuf["); pdec(kbuf_tail); print("->"); pdec(kbuf_head); print("](");
@@ -57,6 +135,16 @@ void vusb_transfer_keyboard(void)
             }
         }
     }
+#ifdef LATENCY_ENABLE
+    // host has read all reports
+    if (kbuf_head == kbuf_tail && usbInterruptIsReady()
+#   ifdef NKRO_ENABLE
+            && !nkro_dirty && usbInterruptIsReady3()
+#   endif
+       ) {
+        latency_sent();
+    }
+#endif
 }
 
 
@@ -88,9 +176,25 @@ static uint8_t keyboard_leds(void) {
 
 static void send_keyboard(report_keyboard_t *report)
 {
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keyboard_nkro) {
+        nkro_flush();
+        nkro_report = *report;
+        nkro_dirty = 0;
+        for (uint8_t i = 0; i < NKRO_CHUNKS; i++) {
+            if (memcmp(&nkro_report.raw[i * NKRO_CHUNK], &nkro_sent.raw[i * NKRO_CHUNK], nkro_chunk_len(i))) {
+                nkro_dirty |= (1<<i);
+            }
+        }
+        usbPoll();
+        vusb_transfer_keyboard();
+        return;
+    }
+#endif
+
     uint8_t next = (kbuf_head + 1) % KBUF_SIZE;
     if (next != kbuf_tail) {
-        kbuf[kbuf_head] = *report;
+        memcpy(&kbuf[kbuf_head], report, sizeof(keyboard_report_t));
         kbuf_head = next;
     } else {
         debug("kbuf: full\n");
@@ -179,13 +283,24 @@ usbRequest_t    *rq = (void *)data;
             return sizeof(keyboard_report);
         }else if(rq->bRequest == USBRQ_HID_GET_IDLE){
             debug("GET_IDLE: ");
-            //debug_hex(vusb_idle_rate);
-            usbMsgPtr = &vusb_idle_rate;
+            //debug_hex(keyboard_idle);
+            usbMsgPtr = &keyboard_idle;
             return 1;
         }else if(rq->bRequest == USBRQ_HID_SET_IDLE){
-            vusb_idle_rate = rq->wValue.bytes[1];
+            keyboard_idle = rq->wValue.bytes[1];
             debug("SET_IDLE: ");
-            debug_hex(vusb_idle_rate);
+            debug_hex(keyboard_idle);
+        }else if(rq->bRequest == USBRQ_HID_GET_PROTOCOL){
+            debug("GET_PROTOCOL: ");
+            usbMsgPtr = &keyboard_protocol;
+            return 1;
+        }else if(rq->bRequest == USBRQ_HID_SET_PROTOCOL){
+            // boot protocol is set only on keyboard interface
+            if (rq->wIndex.word == 0) {
+                keyboard_protocol = rq->wValue.bytes[0];
+            }
+            debug("SET_PROTOCOL: ");
+            debug_hex(keyboard_protocol);
         }else if(rq->bRequest == USBRQ_HID_SET_REPORT){
             debug("SET_REPORT: ");
             // Report Type: 0x02(Out)/ReportID: 0x00(none) && Interface: 0(keyboard)
@@ -356,6 +471,36 @@ const PROGMEM uchar mouse_hid_report[] = {
     0x95, 0x01,                    //   REPORT_COUNT (1)
     0x81, 0x00,                    //   INPUT (Data,Array,Abs)
     0xc0,                          // END_COLLECTION
+#ifdef NKRO_ENABLE
+    /* NKRO keyboard: bitmap in chunks, see nkro_transfer() */
+    0x05, 0x01,                    // USAGE_PAGE (Generic Desktop)
+    0x09, 0x06,                    // USAGE (Keyboard)
+    0xa1, 0x01,                    // COLLECTION (Application)
+    0x05, 0x07,                    //   USAGE_PAGE (Keyboard)
+    0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
+    0x25, 0x01,                    //   LOGICAL_MAXIMUM (1)
+    0x75, 0x01,                    //   REPORT_SIZE (1)
+    0x85, REPORT_ID_NKRO,          //   REPORT_ID (4)
+    0x95, 0x08,                    //   REPORT_COUNT (8)
+    0x19, 0xe0,                    //   USAGE_MINIMUM (Left Control)
+    0x29, 0xe7,                    //   USAGE_MAXIMUM (Right GUI)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x95, 0x30,                    //   REPORT_COUNT (48)
+    0x19, 0x00,                    //   USAGE_MINIMUM (0x00)
+    0x29, 0x2f,                    //   USAGE_MAXIMUM (0x2F)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x85, REPORT_ID_NKRO + 1,      //   REPORT_ID (5)
+    0x95, 0x38,                    //   REPORT_COUNT (56)
+    0x19, 0x30,                    //   USAGE_MINIMUM (0x30)
+    0x29, 0x67,                    //   USAGE_MAXIMUM (0x67)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0x85, REPORT_ID_NKRO + 2,      //   REPORT_ID (6)
+    0x95, 0x10,                    //   REPORT_COUNT (16)
+    0x19, 0x68,                    //   USAGE_MINIMUM (0x68)
+    0x29, 0x77,                    //   USAGE_MAXIMUM (0x77)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
+    0xc0,                          // END_COLLECTION
+#endif
 };
 
 
@@ -18,10 +18,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef VUSB_H
 #define VUSB_H
 
+#include <stdbool.h>
 #include "host_driver.h"
 
 
 host_driver_t *vusb_driver(void);
 void vusb_transfer_keyboard(void);
+bool vusb_keyboard_busy(void);
 
 #endif
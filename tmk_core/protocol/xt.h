@@ -43,9 +43,24 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "wait.h"
 #include "xt_io.h"
 #include "print.h"
+#ifdef XT_USE_INT
+#include "edge_timer.h"
+#endif
+
+/* Clock period is around 100us, longer gap between interrupts means lost
+ * edge or glitch. Used by xt_interrupt.c */
+#ifndef XT_EDGE_TIMEOUT
+#define XT_EDGE_TIMEOUT     250
+#endif
+
 
 void xt_host_init(void);
 uint8_t xt_host_recv(void);
+void xt_host_print_stats(void);
+
+#ifdef XT_USE_INT
+extern edge_stats_t xt_stats;
+#endif
 
 
 /*--------------------------------------------------------------------
@@ -42,12 +42,18 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
-#include "pbuff.h"
+#include "ring_buffer.h"
 #include "xt.h"
 #include "xt_io.h"
 #include "wait.h"
+#include "edge_timer.h"
 #include "print.h"
 
+
+edge_stats_t xt_stats;
+
+RING_BUFFER(pbuf, uint8_t, 32)
+
 void xt_host_init(void)
 {
     XT_INT_INIT();
@@ -68,6 +74,14 @@ ISR(XT_INT_VECT)
 {
     static uint8_t state = 0;
     static uint8_t data = 0;
+    static edge_time_t last;
+
+    // abort frame if elapse XT_EDGE_TIMEOUT from previous interrupt
+    if (edge_timeout(&last, EDGE_TIMER_TICKS(XT_EDGE_TIMEOUT)) && state != 0) {
+        xt_stats.resync++;
+        state = 0;
+        data = 0;
+    }
 
     if (state == 0) {
         if (data_in())
@@ -92,3 +106,10 @@ DONE:
 RETURN:
     return;
 }
+
+void xt_host_print_stats(void)
+{
+    ring_buffer_stats_t b = pbuf_stats();
+    xprintf("xt: dropped:%u high:%u/%u error:%u resync:%u\n",
+            b.dropped, b.high, b.size, xt_stats.error, xt_stats.resync);
+}
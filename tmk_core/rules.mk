@@ -323,6 +323,7 @@ MSG_FLASH = Creating load file for Flash:
 MSG_EEPROM = Creating load file for EEPROM:
 MSG_EXTENDED_LISTING = Creating Extended Listing:
 MSG_SYMBOL_TABLE = Creating Symbol Table:
+MSG_TRACE_TABLE = Creating Trace Event Table:
 MSG_LINKING = Linking:
 MSG_COMPILING = Compiling C:
 MSG_COMPILING_CPP = Compiling C++:
@@ -362,6 +363,9 @@ all: begin gccversion sizebefore build sizeafter end
 # Change the build target to build a HEX file or a library.
 build: elf hex eep lss sym
 #build: lib
+ifdef TRACE_ENABLE
+build: trace
+endif
 
 
 elf: $(TARGET).elf
@@ -369,6 +373,7 @@ hex: $(TARGET).hex
 eep: $(TARGET).eep
 lss: $(TARGET).lss
 sym: $(TARGET).sym
+trace: $(TARGET).trace
 LIBNAME=lib$(TARGET).a
 lib: $(LIBNAME)
 
@@ -525,6 +530,12 @@ extcoff: $(TARGET).elf
 	@echo $(MSG_SYMBOL_TABLE) $@
 	$(NM) -n $< > $@
 
+# Create trace event table for tool/trace.
+%.trace: $(TMK_DIR)/common/trace_events.h
+	@echo
+	@echo $(MSG_TRACE_TABLE) $@
+	$(CC) -E -P -x c -DTRACE_TABLE $< > $@
+
 
 
 # Create library from object files.
@@ -596,6 +607,7 @@ clean_list :
 	$(REMOVE) $(TARGET).map
 	$(REMOVE) $(TARGET).sym
 	$(REMOVE) $(TARGET).lss
+	$(REMOVE) $(TARGET).trace
 	$(REMOVE) $(OBJ)
 	$(REMOVE) $(LST)
 	$(REMOVE) $(OBJ:.o=.s)
@@ -618,6 +630,6 @@ $(shell mkdir $(OBJDIR) 2>/dev/null)
 
 # Listing of phony targets.
 .PHONY : all begin finish end sizebefore sizeafter gccversion \
-build elf hex eep lss sym coff extcoff \
+build elf hex eep lss sym trace coff extcoff \
 clean clean_list debug gdb-config show_path \
 program teensy dfu flip dfu-ee flip-ee dfu-start
@@ -0,0 +1,182 @@
+/*
+Copyright 2026 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * Decoder of binary trace on console(TRACE_ENABLE)
+ *
+ * Usage: tmk_trace <table> <device>
+ *   table   $(TARGET).trace made by firmware build, for other builds
+ *           cc -E -P -x c -DTRACE_TABLE common/trace_events.h > table
+ *   device  /dev/hidrawN of console interface, or - for stdin
+ *
+ * Text of print() is passed through and records are shown one per line
+ * with time in ms. See common/trace.c for the record format.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#define EVENTS_MAX  256
+#define FORMAT_MAX  128
+#define RECORD_LEN  10      // bytes on wire
+
+static char names[EVENTS_MAX][64];
+static char formats[EVENTS_MAX][FORMAT_MAX];
+static int nevents;
+
+
+/* Table line: NAME "format" */
+static void load_table(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) && nevents < EVENTS_MAX) {
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0') continue;
+
+        char *q = strchr(p, '"');
+        char *e = strrchr(p, '"');
+        if (!q || q == e) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            exit(1);
+        }
+        *e = '\0';
+        snprintf(formats[nevents], FORMAT_MAX, "%.127s", q + 1);
+
+        while (q > p && isspace((unsigned char)q[-1])) q--;
+        *q = '\0';
+        snprintf(names[nevents], sizeof(names[0]), "%.63s", p);
+        nevents++;
+    }
+    fclose(f);
+}
+
+/* Format may have up to two integer conversions, others are not safe with
+ * our two arguments */
+static int format_ok(const char *fmt)
+{
+    int n = 0;
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') continue;
+        p++;
+        if (*p == '%') continue;
+        while (*p && strchr("-+ #0123456789", *p)) p++;
+        if (!*p || !strchr("diuxXoc", *p)) return 0;
+        if (++n > 2) return 0;
+    }
+    return 1;
+}
+
+static void print_record(const uint8_t *raw)
+{
+    static uint32_t high;
+    static uint16_t last;
+
+    uint8_t id = raw[0];
+    uint16_t time = raw[1] | raw[2]<<8;
+    unsigned int a = raw[3] | raw[4]<<8;
+    unsigned int b = raw[5] | raw[6]<<8;
+
+    // time stamp is 16-bit ms, gaps longer than 65s are not counted
+    if (time < last) high += 0x10000;
+    last = time;
+    printf("[%9lu] ", (unsigned long)(high + time));
+
+    if (id >= nevents) {
+        printf("unknown id:%u %04X %04X\n", id, a, b);
+    } else if (!format_ok(formats[id])) {
+        printf("%s %04X %04X\n", names[id], a, b);
+    } else {
+        printf(formats[id], a, b);
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <table> <device>\n", argv[0]);
+        return 1;
+    }
+    load_table(argv[1]);
+
+    int fd = strcmp(argv[2], "-") ? open(argv[2], O_RDONLY) : 0;
+    if (fd < 0) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    uint8_t buf[64];
+    uint8_t raw[7];
+    int pos = -1;           // bytes of record, -1 out of record
+    int n = 0;              // bytes decoded
+    uint16_t acc = 0;
+    int bits = 0;
+    int column = 0;
+    ssize_t len;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            uint8_t c = buf[i];
+
+            if ((c & 0xC0) == 0xC0) {
+                // start of record, partial one before is dropped
+                pos = 0;
+                n = 0;
+                acc = 0;
+                bits = 0;
+            } else if ((c & 0xC0) != 0x80) {
+                // text, zero is padding of console packet
+                if (c) {
+                    putchar(c);
+                    column = (c == '\n') ? 0 : column + 1;
+                }
+                continue;
+            } else if (pos < 0) {
+                continue;
+            }
+
+            acc |= (uint16_t)(c & 0x3F) << bits;
+            bits += 6;
+            if (bits >= 8 && n < (int)sizeof(raw)) {
+                raw[n++] = acc & 0xFF;
+                acc >>= 8;
+                bits -= 8;
+            }
+            if (++pos == RECORD_LEN) {
+                if (column) {
+                    putchar('\n');
+                    column = 0;
+                }
+                print_record(raw);
+                pos = -1;
+            }
+        }
+    }
+    return 0;
+}